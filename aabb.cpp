@@ -22,12 +22,29 @@ AABBox::AABBox()
 }
 
 AABBox::AABBox(const Mesh& mesh)
+{
+    reset();
+    extend(mesh.data(), mesh.size());
+}
+
+AABBox::AABBox(const IndexedMesh& mesh)
+{
+    reset();
+    extend(mesh.vertices.data(), mesh.vertices.size());
+}
+
+void AABBox::reset()
 {
     lower = { std::numeric_limits<float>::max(), std::numeric_limits<float>::max(), std::numeric_limits<float>::max() };
     upper = { -std::numeric_limits<float>::max(), -std::numeric_limits<float>::max(), -std::numeric_limits<float>::max() };
+}
 
-    for (const auto& t : mesh)
+void AABBox::extend(const Triangle* triangles, size_t count)
+{
+    for (size_t i = 0; i < count; ++i)
     {
+        const Triangle& t = triangles[i];
+
         lower.x = std::min(std::min(lower.x, t.vertices[0].x), std::min(t.vertices[1].x, t.vertices[2].x));
         lower.y = std::min(std::min(lower.y, t.vertices[0].y), std::min(t.vertices[1].y, t.vertices[2].y));
         lower.z = std::min(std::min(lower.z, t.vertices[0].z), std::min(t.vertices[1].z, t.vertices[2].z));
@@ -37,3 +54,19 @@ AABBox::AABBox(const Mesh& mesh)
         upper.z = std::max(std::max(upper.z, t.vertices[0].z), std::max(t.vertices[1].z, t.vertices[2].z));
     }
 }
+
+void AABBox::extend(const Vec3* points, size_t count)
+{
+    for (size_t i = 0; i < count; ++i)
+    {
+        const Vec3& p = points[i];
+
+        lower.x = std::min(lower.x, p.x);
+        lower.y = std::min(lower.y, p.y);
+        lower.z = std::min(lower.z, p.z);
+
+        upper.x = std::max(upper.x, p.x);
+        upper.y = std::max(upper.y, p.y);
+        upper.z = std::max(upper.z, p.z);
+    }
+}
@@ -17,6 +17,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #pragma once
 
+#include "indexed_mesh.h"
 #include "triangle.h"
 #include <limits>
 
@@ -28,6 +29,12 @@ struct AABBox
 
     AABBox();
     explicit AABBox(const Mesh& mesh);
+    explicit AABBox(const IndexedMesh& mesh);
+
+    // makes the box empty, so that the next extend() sets it to the extended triangles
+    void reset();
+    void extend(const Triangle* triangles, size_t count);
+    void extend(const Vec3* points, size_t count);
 
     float stride() const
     {
@@ -17,6 +17,9 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #pragma once
 
+#include <vector>
+#include "aabb.h"
+#include "indexed_mesh.h"
 #include "picture.h"
 #include "triangle.h"
 
@@ -25,4 +28,19 @@ class BackendInterface
 public:
     virtual ~BackendInterface()                            = default;
     virtual int render(Picture& pic, const Mesh& mesh, const Vec3& view_pos) = 0;
+
+    // renders pics[i] as seen from view_pos[i], with a single pass over the mesh
+    virtual int render(const std::vector<Picture*>& pics, const Mesh& mesh, const std::vector<Vec3>& view_pos) = 0;
+    virtual int render(Picture& pic, const IndexedMesh& mesh, const Vec3& view_pos) = 0;
+    virtual int render(const std::vector<Picture*>& pics, const IndexedMesh& mesh, const std::vector<Vec3>& view_pos) = 0;
+
+    // the same with the model bounds known up front, so the mesh is not walked to find them
+    virtual int render(const std::vector<Picture*>& pics, const Mesh& mesh, const AABBox& aabb, const std::vector<Vec3>& view_pos)        = 0;
+    virtual int render(const std::vector<Picture*>& pics, const IndexedMesh& mesh, const AABBox& aabb, const std::vector<Vec3>& view_pos) = 0;
+
+    // streaming: begin() with the bounds of the whole model, then draw() any number
+    // of triangle batches and end() once all of them have been submitted
+    virtual int begin(const std::vector<Picture*>& pics, const AABBox& aabb, const std::vector<Vec3>& view_pos) = 0;
+    virtual void draw(const Triangle* triangles, size_t count)                                                 = 0;
+    virtual void end()                                                                                         = 0;
 };
@@ -20,6 +20,9 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include <glm/gtc/matrix_transform.hpp>
 #include "aabb.h"
 #include "zbuffer.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
 
 // helpers
 static glm::vec3 vec3ToGlm(const Vec3& v)
@@ -27,19 +30,36 @@ static glm::vec3 vec3ToGlm(const Vec3& v)
     return { v.x, v.y, v.z };
 }
 
-static float edgeFunction(glm::vec2 p, glm::vec2 a, glm::vec2 b)
+static glm::vec3 glmMat4x4MulVec3(const glm::mat4x4& mat, glm::vec3 v)
 {
-    return (p.x - a.x) * (b.y - a.y) - (p.y - a.y) * (b.x - a.x);
+    return glm::vec3(mat * glm::vec4{ v.x, v.y, v.z, 1.0f });
 }
 
-static glm::vec3 glmMat4x4MulVec3(const glm::mat4x4& mat, glm::vec3 v)
+// the coverage test of the kernels for a single sample
+static bool covers(const RasterTriangle& t, int64_t x, int64_t y)
 {
-    return glm::vec3(mat * glm::vec4{ v.x, v.y, v.z, 1.0f });
+    for (int k = 0; k < 3; ++k)
+    {
+        if (t.edgeA[k] * x + t.edgeB[k] * y + t.edgeC[k] < 0)
+        {
+            return false;
+        }
+    }
+    return true;
 }
 
+static_assert(ZBuffer::BLOCK_SIZE == RASTER_BLOCK_SIZE, "the hierarchical z blocks are the raster blocks");
+
+// std::min takes them by reference
+const size_t RasterBackend::RENDER_BATCH_SIZE;
+const size_t RasterBackend::TRANSFORM_CHUNK_SIZE;
+
 //
 RasterBackend::RasterBackend(size_t width, size_t height) : m_width(width), m_height(height)
 {
+    m_tilesX    = (m_width + TILE_SIZE - 1) / TILE_SIZE;
+    m_tilesY    = (m_height + TILE_SIZE - 1) / TILE_SIZE;
+    m_kernels   = selectRasterKernels();
 }
 
 RasterBackend::~RasterBackend()
@@ -48,97 +68,678 @@ RasterBackend::~RasterBackend()
 
 int RasterBackend::render(Picture& pic, const Mesh& mesh, const Vec3& view_pos)
 {
-    ZBuffer zbuffer(m_width, m_height);
-//    pic.fill(m_backgroundColor.x, m_backgroundColor.y, m_backgroundColor.z, m_backgroundColor.w); // 设置背景色
-    pic.setBackground();
+    return render({ &pic }, mesh, { view_pos });
+}
 
-    // generate AABB and find its center
-    auto aabb          = AABBox(mesh);
+int RasterBackend::render(const std::vector<Picture*>& pics, const Mesh& mesh, const std::vector<Vec3>& view_pos)
+{
+    // generate AABB, shared by all views
+    return render(pics, mesh, AABBox(mesh), view_pos);
+}
+
+int RasterBackend::render(const std::vector<Picture*>& pics, const Mesh& mesh, const AABBox& aabb, const std::vector<Vec3>& view_pos)
+{
+    int ret = begin(pics, aabb, view_pos);
+    if (ret != 0)
+    {
+        return ret;
+    }
+
+    if (m_frontToBack)
+    {
+        auto sortTask = [&](size_t v) {
+            View& view = m_views[v];
+            sortFrontToBack(view, mesh.size(), [&](size_t i) {
+                const Triangle& t = mesh[i];
+                return project(view, t.vertices[0]).z + project(view, t.vertices[1]).z + project(view, t.vertices[2]).z;
+            });
+        };
+
+        pool().run(m_viewCount, sortTask);
+    }
+
+    // set up in batches, so the per view buffers do not grow with the mesh
+    for (size_t first = 0; first < mesh.size() && !cancelled(); first += RENDER_BATCH_SIZE)
+    {
+        const size_t count = std::min(RENDER_BATCH_SIZE, mesh.size() - first);
+
+        auto setupBatch = [&](View& view) {
+            setup(view, mesh.data(), first, count);
+        };
+
+        draw(setupBatch, m_deferredShading);
+    }
+
+    if (m_deferredShading && !mesh.empty() && !cancelled())
+    {
+        shade(&mesh.front().normal, sizeof(Triangle));
+    }
+
+    end();
+
+    return m_cancelled ? -1 : 0;
+}
+
+int RasterBackend::render(Picture& pic, const IndexedMesh& mesh, const Vec3& view_pos)
+{
+    return render({ &pic }, mesh, { view_pos });
+}
+
+int RasterBackend::render(const std::vector<Picture*>& pics, const IndexedMesh& mesh, const std::vector<Vec3>& view_pos)
+{
+    return render(pics, mesh, AABBox(mesh), view_pos);
+}
+
+int RasterBackend::render(const std::vector<Picture*>& pics, const IndexedMesh& mesh, const AABBox& aabb, const std::vector<Vec3>& view_pos)
+{
+    int ret = begin(pics, aabb, view_pos);
+    if (ret != 0)
+    {
+        return ret;
+    }
+
+    // every vertex is transformed once per view, the triangles only look them up
+    transform(mesh);
+
+    if (m_frontToBack)
+    {
+        auto sortTask = [&](size_t v) {
+            View& view = m_views[v];
+            sortFrontToBack(view, mesh.size(), [&](size_t i) {
+                const uint32_t* indices = &mesh.indices[3 * i];
+                return view.vertices[indices[0]].z + view.vertices[indices[1]].z + view.vertices[indices[2]].z;
+            });
+        };
+
+        pool().run(m_viewCount, sortTask);
+    }
+
+    for (size_t first = 0; first < mesh.size() && !cancelled(); first += RENDER_BATCH_SIZE)
+    {
+        const size_t count = std::min(RENDER_BATCH_SIZE, mesh.size() - first);
+
+        auto setupBatch = [&](View& view) {
+            setup(view, mesh, first, count);
+        };
+
+        draw(setupBatch, m_deferredShading);
+    }
+
+    if (m_deferredShading && !mesh.normals.empty() && !cancelled())
+    {
+        shade(mesh.normals.data(), sizeof(Vec3));
+    }
+
+    end();
+
+    return m_cancelled ? -1 : 0;
+}
+
+int RasterBackend::begin(Picture& pic, const AABBox& aabb, const Vec3& view_pos)
+{
+    return begin({ &pic }, aabb, { view_pos });
+}
+
+int RasterBackend::begin(const std::vector<Picture*>& pics, const AABBox& aabb, const std::vector<Vec3>& view_pos)
+{
+    if (pics.size() != view_pos.size())
+    {
+        return -1;
+    }
+
+    // find the center of the AABB
     auto largestStride = aabb.stride();
     auto center        = vec3ToGlm(aabb.center());
 
-    // create model view projection matrix
-    const float zoom   = 1.0f;
-    auto projection    = glm::ortho(zoom * .5f, -zoom * .5f, -zoom * .5f, zoom * .5f, 0.0f, 1.0f);
-    auto viewPos       = glm::vec3{ view_pos.x, view_pos.y, view_pos.z };
-    auto view          = glm::lookAt(viewPos, glm::vec3{ 0.f, 0.f, 0.f }, { 0.f, 0.f, 1.f });
-    auto model         = glm::scale(glm::mat4(1), glm::vec3{ 1.0f / largestStride }) * glm::translate(glm::mat4(1), -center);
-    auto modelViewProj = projection * view * model;
-
-    for (const auto& t : mesh)
-    {
-        // project vertices to screen coordinates
-        auto v0 = glmMat4x4MulVec3(modelViewProj, vec3ToGlm(t.vertices[0]));
-        auto v1 = glmMat4x4MulVec3(modelViewProj, vec3ToGlm(t.vertices[1]));
-        auto v2 = glmMat4x4MulVec3(modelViewProj, vec3ToGlm(t.vertices[2]));
-
-        // triangle bounding box
-        float minX = std::min(v0.x, std::min(v1.x, v2.x));
-        float minY = std::min(v0.y, std::min(v1.y, v2.y));
-        float maxX = std::max(v0.x, std::max(v1.x, v2.x));
-        float maxY = std::max(v0.y, std::max(v1.y, v2.y));
-
-        // bounding box in screen space
-        unsigned sminX = static_cast<unsigned>(std::max(0, static_cast<int>((minX + 1.0f) / 2.0f * m_width)));
-        unsigned sminY = static_cast<unsigned>(std::max(0, static_cast<int>((minY + 1.0f) / 2.0f * m_height)));
-        unsigned smaxX = static_cast<unsigned>(std::max(0, std::min(int(m_width), static_cast<int>((maxX + 1.0f) / 2.0f * m_width))));
-        unsigned smaxY = static_cast<unsigned>(std::max(0, std::min(int(m_height), static_cast<int>((maxY + 1.0f) / 2.0f * m_height))));
-
-        for (unsigned y = sminY; y < smaxY + 1; ++y)
+    // the model matrix and the projection do not depend on the view
+    const float zoom = 1.0f;
+    auto projection  = glm::ortho(zoom * .5f, -zoom * .5f, -zoom * .5f, zoom * .5f, 0.0f, 1.0f);
+    auto model       = glm::scale(glm::mat4(1), glm::vec3{ 1.0f / largestStride }) * glm::translate(glm::mat4(1), -center);
+
+    while (m_views.size() < pics.size())
+    {
+        m_views.emplace_back(m_width, m_height);
+        m_views.back().bins.resize(m_tilesX * m_tilesY);
+    }
+
+    m_viewCount = pics.size();
+    m_cancelled = false;
+
+    // every channel is saturated once the light reaches 1 / (weakest channel of the model color)
+    float levelScale = 0.0f;
+    if (m_shadingLevels > 0)
+    {
+        float weakest = 1.0f;
+        for (float c : { m_modelColor.x, m_modelColor.y, m_modelColor.z })
         {
-            for (unsigned x = sminX; x < smaxX + 1; ++x)
+            if (c > 0.0f)
             {
-                // normalize screen coords [-1,1]
-                const float nx = 2.f * (x / static_cast<float>(m_width) - 0.5f);
-                const float ny = 2.f * (y / static_cast<float>(m_height) - 0.5f);
-
-                auto P  = glm::vec2{ nx, ny };
-                auto V0 = glm::vec2(v0);
-                auto V1 = glm::vec2(v1);
-                auto V2 = glm::vec2(v2);
-
-                bool inside = true;
-                inside &= edgeFunction(P, V0, V1) <= 0.0f;
-                inside &= edgeFunction(P, V1, V2) <= 0.0f;
-                inside &= edgeFunction(P, V2, V0) <= 0.0f;
-
-                if (inside)
-                {
-                    // calculate baricentric coords
-                    float area = edgeFunction(V0, V1, V2);
-                    float w0   = edgeFunction(V1, V2, P) / area;
-                    float w1   = edgeFunction(V2, V0, P) / area;
-                    float w2   = edgeFunction(V0, V1, P) / area;
-
-                    // the z position at point p by interpolating the z position of all 3 vertices
-                    float pz = w0 * v0.z + w1 * v1.z + w2 * v2.z;
-                    float px = w0 * v0.x + w1 * v1.x + w2 * v2.x;
-                    float py = w0 * v0.y + w1 * v1.y + w2 * v2.y;
-
-                    if (zbuffer.testAndSet(x, y, pz))
-                    {
-                        // calculate lightning
-                        // diffuse
-                        Vec3 s2l       = m_lightPos - Vec3{ px, py, pz };
-                        Vec3 diffColor = std::max(0.0f, dot(t.normal, s2l)) * m_diffuseColor;
-
-                        // specular
-                        Vec3 fragPos    = { px, py, pz };
-                        Vec3 lightDir   = (m_lightPos - fragPos).normalize();
-                        Vec3 viewDir    = (Vec3{ viewPos.x, viewPos.y, viewPos.z } - fragPos).normalize();
-                        Vec3 reflectDir = reflect(-lightDir, t.normal);
-                        Vec3 specColor  = std::pow(std::max(dot(viewDir, reflectDir), 0.0f), 1.0f) * m_specColor * 0.7f;
-
-                        // merge
-                        Vec3 color = (m_ambientColor + diffColor + specColor) * m_modelColor;
-
-                        // output pixel color
-                        pic.setRGB(x, y, color.x, color.y, color.z);
-                    }
-                }
+                weakest = std::min(weakest, c);
             }
         }
+        levelScale = m_shadingLevels * weakest;
+    }
+
+    for (size_t i = 0; i < m_viewCount; ++i)
+    {
+        View& v   = m_views[i];
+        v.pic     = pics[i];
+        v.viewPos = view_pos[i];
+
+        v.order.clear();
+        v.counters.assign(m_tilesX * m_tilesY, RasterCounters{});
+
+        // create model view projection matrix
+        auto viewPos    = vec3ToGlm(v.viewPos);
+        auto view       = glm::lookAt(viewPos, glm::vec3{ 0.f, 0.f, 0.f }, { 0.f, 0.f, 1.f });
+        v.modelViewProj = projection * view * model;
+
+        v.shading = {
+            { m_lightPos.x, m_lightPos.y, m_lightPos.z },
+            { v.viewPos.x, v.viewPos.y, v.viewPos.z },
+            { m_ambientColor.x, m_ambientColor.y, m_ambientColor.z },
+            { m_diffuseColor.x, m_diffuseColor.y, m_diffuseColor.z },
+            { m_specColor.x, m_specColor.y, m_specColor.z },
+            { m_modelColor.x, m_modelColor.y, m_modelColor.z },
+            levelScale,
+        };
     }
 
+    // clear the targets of all views in parallel, the depths tile by tile
+    const size_t tileCount = m_tilesX * m_tilesY;
+
+    auto clearTask = [&](size_t task) {
+        View& view        = m_views[task / (tileCount + 1)];
+        const size_t tile = task % (tileCount + 1);
+
+        if (tile == tileCount)
+        {
+//            view.pic->fill(m_backgroundColor.x, m_backgroundColor.y, m_backgroundColor.z, m_backgroundColor.w); // 设置背景色
+            view.pic->setBackground();
+        }
+        else
+        {
+            view.zbuffer.clearTile(tile % m_tilesX, tile / m_tilesX);
+        }
+    };
+
+    pool().run(m_viewCount * (tileCount + 1), clearTask);
+
     return 0;
 }
+
+void RasterBackend::setThreadCount(unsigned count)
+{
+    if (count != m_threadCount)
+    {
+        m_threadCount = count;
+        m_pool.reset();
+    }
+}
+
+void RasterBackend::setDeferredShading(bool enable)
+{
+    m_deferredShading = enable;
+}
+
+void RasterBackend::setBackFaceCulling(bool enable)
+{
+    m_backFaceCulling = enable;
+}
+
+void RasterBackend::setShadingLevels(unsigned levels)
+{
+    m_shadingLevels = levels;
+}
+
+void RasterBackend::setFrontToBack(bool enable)
+{
+    m_frontToBack = enable;
+}
+
+void RasterBackend::setCancel(std::function<bool()> cancel)
+{
+    m_cancel = std::move(cancel);
+}
+
+RasterCounters RasterBackend::counters() const
+{
+    return m_counters;
+}
+
+size_t RasterBackend::footprint(size_t width, size_t height, size_t views)
+{
+    const size_t tiles = ((width + TILE_SIZE - 1) / TILE_SIZE) * ((height + TILE_SIZE - 1) / TILE_SIZE);
+
+    // every triangle of a batch lands in one bin at least, large ones in more
+    const size_t perTile  = TILE_SIZE * TILE_SIZE * sizeof(uint32_t) + sizeof(RasterCounters) + sizeof(std::vector<uint32_t>);
+    const size_t batch    = RENDER_BATCH_SIZE * (sizeof(RasterTriangle) + sizeof(uint32_t));
+    const size_t buckets  = (DEPTH_BUCKETS + 1) * sizeof(size_t);
+
+    return views * (ZBuffer::footprint(width, height) + tiles * perTile + batch + buckets);
+}
+
+size_t RasterBackend::meshFootprint(size_t vertices, size_t triangles, size_t views, bool frontToBack)
+{
+    size_t view = vertices * sizeof(ScreenVertex);
+    if (frontToBack)
+    {
+        const size_t clusters = (triangles + DEPTH_CLUSTER_SIZE - 1) / DEPTH_CLUSTER_SIZE;
+        view += triangles * sizeof(uint32_t) + clusters * (sizeof(float) + sizeof(uint16_t));
+    }
+
+    return views * view;
+}
+
+void RasterBackend::transform(const IndexedMesh& mesh)
+{
+    std::vector<RasterTransform>& transforms = m_transforms;
+    transforms.resize(m_viewCount);
+
+    for (size_t v = 0; v < m_viewCount; ++v)
+    {
+        View& view = m_views[v];
+        view.vertices.resize(mesh.vertices.size());
+
+        RasterTransform& t = transforms[v];
+        for (int c = 0; c < 4; ++c)
+        {
+            for (int r = 0; r < 4; ++r)
+            {
+                t.matrix[c * 4 + r] = view.modelViewProj[c][r];
+            }
+        }
+
+        t.width  = float(m_width);
+        t.height = float(m_height);
+        t.out    = view.vertices.empty() ? nullptr : &view.vertices[0].x;
+    }
+
+    if (mesh.vertices.empty())
+    {
+        return;
+    }
+
+    // all views in one pass over the vertices, split into chunks for the thread pool
+    const size_t chunks = (mesh.vertices.size() + TRANSFORM_CHUNK_SIZE - 1) / TRANSFORM_CHUNK_SIZE;
+
+    auto transformTask = [&](size_t chunk) {
+        const size_t first = chunk * TRANSFORM_CHUNK_SIZE;
+        const size_t count = std::min(TRANSFORM_CHUNK_SIZE, mesh.vertices.size() - first);
+
+        m_kernels.transform(&mesh.vertices[0].x, first, count, transforms.data(), transforms.size());
+    };
+
+    pool().run(chunks, transformTask);
+}
+
+ThreadPool& RasterBackend::pool()
+{
+    if (!m_pool)
+    {
+        m_pool.reset(new ThreadPool(m_threadCount));
+    }
+
+    return *m_pool;
+}
+
+bool RasterBackend::cancelled()
+{
+    if (!m_cancelled && m_cancel && m_cancel())
+    {
+        m_cancelled = true;
+    }
+
+    return m_cancelled;
+}
+
+void RasterBackend::draw(const Triangle* triangles, size_t count)
+{
+    auto setupBatch = [&](View& view) {
+        setup(view, triangles, 0, count);
+    };
+
+    draw(setupBatch, false);
+}
+
+template <typename Setup>
+void RasterBackend::draw(const Setup& setupBatch, bool deferred)
+{
+    // project every triangle and sort it into the screen tiles it touches
+    auto setupTask = [&](size_t v) {
+        View& view = m_views[v];
+        if (deferred)
+        {
+            view.ids.resize(view.zbuffer.tilesX() * view.zbuffer.tilesY() * TILE_SIZE * TILE_SIZE);
+        }
+
+        setupBatch(view);
+    };
+
+    pool().run(m_viewCount, setupTask);
+
+    // rasterize the tiles of all views in parallel. A tile is only ever touched by one
+    // thread and sees its triangles in submission order, so no locks are needed and the
+    // result is the same as rasterizing serially
+    const size_t tileCount = m_tilesX * m_tilesY;
+
+    auto rasterTask = [&](size_t task) {
+        if (!cancelled())
+        {
+            rasterizeTile(m_views[task / tileCount], task % tileCount, deferred);
+        }
+    };
+
+    pool().run(m_viewCount * tileCount, rasterTask);
+}
+
+void RasterBackend::shade(const void* normals, size_t stride)
+{
+    const size_t tileCount = m_tilesX * m_tilesY;
+
+    auto shadeTask = [&](size_t task) {
+        View& view = m_views[task / tileCount];
+        m_kernels.shadeTile(normals, stride, target(view, task % tileCount, true), view.shading);
+    };
+
+    pool().run(m_viewCount * tileCount, shadeTask);
+}
+
+template <typename Depth>
+void RasterBackend::sortFrontToBack(View& view, size_t count, const Depth& depth)
+{
+    // the mean depth of every cluster and their range, larger depths are nearer
+    const size_t clusters = (count + DEPTH_CLUSTER_SIZE - 1) / DEPTH_CLUSTER_SIZE;
+    std::vector<float>& depths = view.clusterDepths;
+    depths.resize(clusters);
+
+    float nearest  = -std::numeric_limits<float>::infinity();
+    float farthest = std::numeric_limits<float>::infinity();
+    for (size_t c = 0; c < clusters; ++c)
+    {
+        const size_t end = std::min(count, (c + 1) * DEPTH_CLUSTER_SIZE);
+
+        double sum = 0.0;
+        for (size_t i = c * DEPTH_CLUSTER_SIZE; i < end; ++i)
+        {
+            sum += depth(i);
+        }
+
+        depths[c] = float(sum / (end - c * DEPTH_CLUSTER_SIZE));
+        if (std::isfinite(depths[c]))
+        {
+            nearest  = std::max(nearest, depths[c]);
+            farthest = std::min(farthest, depths[c]);
+        }
+    }
+
+    // a counting sort on the bucket, so every bucket keeps the mesh order. Clusters
+    // without a usable depth go last
+    const float scale = nearest > farthest ? (DEPTH_BUCKETS - 1) / (nearest - farthest) : 0.0f;
+
+    std::vector<uint16_t>& buckets = view.clusterBuckets;
+    std::vector<size_t>& starts    = view.bucketStarts;
+    buckets.resize(clusters);
+    starts.assign(DEPTH_BUCKETS + 1, 0);
+
+    for (size_t c = 0; c < clusters; ++c)
+    {
+        const float d = depths[c];
+        buckets[c]    = uint16_t(std::isfinite(d) ? std::min<float>(DEPTH_BUCKETS - 1, (nearest - d) * scale) : DEPTH_BUCKETS - 1);
+        starts[buckets[c] + 1] += std::min(count, (c + 1) * DEPTH_CLUSTER_SIZE) - c * DEPTH_CLUSTER_SIZE;
+    }
+
+    for (size_t b = 1; b <= DEPTH_BUCKETS; ++b)
+    {
+        starts[b] += starts[b - 1];
+    }
+
+    view.order.resize(count);
+    for (size_t c = 0; c < clusters; ++c)
+    {
+        const size_t end = std::min(count, (c + 1) * DEPTH_CLUSTER_SIZE);
+        for (size_t i = c * DEPTH_CLUSTER_SIZE; i < end; ++i)
+        {
+            view.order[starts[buckets[c]]++] = uint32_t(i);
+        }
+    }
+}
+
+void RasterBackend::end()
+{
+    m_counters = {};
+
+    for (size_t i = 0; i < m_viewCount; ++i)
+    {
+        m_views[i].pic = nullptr;
+
+        for (const RasterCounters& c : m_views[i].counters)
+        {
+            m_counters.fragments += c.fragments;
+            m_counters.rejected += c.rejected;
+            m_counters.culledTriangles += c.culledTriangles;
+            m_counters.culledBlocks += c.culledBlocks;
+        }
+    }
+
+    m_viewCount = 0;
+}
+
+void RasterBackend::clearBatch(View& view)
+{
+    view.triangles.clear();
+    for (auto& bin : view.bins)
+    {
+        bin.clear();
+    }
+}
+
+RasterBackend::ScreenVertex RasterBackend::project(const View& view, const Vec3& v) const
+{
+    // project vertices to screen coordinates, the viewport maps [-1,1] to [0,width]
+    auto p = glmMat4x4MulVec3(view.modelViewProj, vec3ToGlm(v));
+    return { (p.x + 1.0f) / 2.0f * m_width, (p.y + 1.0f) / 2.0f * m_height, p.z };
+}
+
+void RasterBackend::setup(View& view, const Triangle* triangles, size_t first, size_t count)
+{
+    clearBatch(view);
+
+    for (size_t i = first; i < first + count; ++i)
+    {
+        const size_t id   = view.order.empty() ? i : view.order[i];
+        const Triangle& t = triangles[id];
+        setupTriangle(view, project(view, t.vertices[0]), project(view, t.vertices[1]), project(view, t.vertices[2]), t.normal, id);
+    }
+}
+
+void RasterBackend::setup(View& view, const IndexedMesh& mesh, size_t first, size_t count)
+{
+    clearBatch(view);
+
+    for (size_t i = first; i < first + count; ++i)
+    {
+        const size_t id         = view.order.empty() ? i : view.order[i];
+        const uint32_t* indices = &mesh.indices[3 * id];
+        setupTriangle(view, view.vertices[indices[0]], view.vertices[indices[1]], view.vertices[indices[2]], mesh.normals[id], id);
+    }
+}
+
+void RasterBackend::setupTriangle(View& view, const ScreenVertex& v0, const ScreenVertex& v1, const ScreenVertex& v2, const Vec3& normal, size_t id)
+{
+    // snap to the sub-pixel grid, pixel x samples the screen at x
+    const float one  = float(1 << RASTER_SUBPIXEL_BITS);
+    float sx[] = { v0.x, v1.x, v2.x };
+    float sy[] = { v0.y, v1.y, v2.y };
+    float sz[] = { v0.z, v1.z, v2.z };
+
+    if (!std::isfinite(sx[0] + sx[1] + sx[2] + sy[0] + sy[1] + sy[2]))
+    {
+        return;
+    }
+
+    int64_t X[3], Y[3];
+    for (int k = 0; k < 3; ++k)
+    {
+        X[k] = std::llround(sx[k] * one);
+        Y[k] = std::llround(sy[k] * one);
+    }
+
+    // twice the signed area, degenerate triangles cover nothing. The other winding faces away
+    // from the camera, drawn reversed unless it is culled
+    const int64_t area = (X[1] - X[0]) * (Y[2] - Y[0]) - (X[2] - X[0]) * (Y[1] - Y[0]);
+    if (area == 0 || (area < 0 && m_backFaceCulling))
+    {
+        return;
+    }
+
+    const bool flip = area < 0;
+    if (flip)
+    {
+        std::swap(X[1], X[2]);
+        std::swap(Y[1], Y[2]);
+        std::swap(sx[1], sx[2]);
+        std::swap(sy[1], sy[2]);
+        std::swap(sz[1], sz[2]);
+    }
+
+    // bounding box of the covered samples
+    const int64_t minX = std::min(X[0], std::min(X[1], X[2]));
+    const int64_t minY = std::min(Y[0], std::min(Y[1], Y[2]));
+    const int64_t maxX = std::max(X[0], std::max(X[1], X[2]));
+    const int64_t maxY = std::max(Y[0], std::max(Y[1], Y[2]));
+
+    const int64_t round = (1 << RASTER_SUBPIXEL_BITS) - 1;
+    int sminX           = int(std::max<int64_t>(0, (minX + round) >> RASTER_SUBPIXEL_BITS));
+    int sminY           = int(std::max<int64_t>(0, (minY + round) >> RASTER_SUBPIXEL_BITS));
+    int smaxX           = int(std::min<int64_t>(m_width - 1, maxX >> RASTER_SUBPIXEL_BITS));
+    int smaxY           = int(std::min<int64_t>(m_height - 1, maxY >> RASTER_SUBPIXEL_BITS));
+
+    if (sminX > smaxX || sminY > smaxY)
+    {
+        return; // off screen or between the samples
+    }
+
+    RasterTriangle rt;
+
+    // edge functions, positive inside. Samples exactly on an edge belong to the
+    // triangle if the edge is a top or a left edge
+    for (int k = 0; k < 3; ++k)
+    {
+        const int a      = k;
+        const int b      = (k + 1) % 3;
+        const int64_t dx = X[b] - X[a];
+        const int64_t dy = Y[b] - Y[a];
+        const bool topLeft = dy < 0 || (dy == 0 && dx > 0);
+
+        rt.edgeA[k] = int32_t(-dy * (1 << RASTER_SUBPIXEL_BITS));
+        rt.edgeB[k] = int32_t(dx * (1 << RASTER_SUBPIXEL_BITS));
+        rt.edgeC[k] = X[a] * dy - Y[a] * dx - (topLeft ? 0 : 1);
+    }
+
+    // depth plane through the unsnapped vertices
+    const double e1x = double(sx[1]) - sx[0], e1y = double(sy[1]) - sy[0], e1z = double(sz[1]) - sz[0];
+    const double e2x = double(sx[2]) - sx[0], e2y = double(sy[2]) - sy[0], e2z = double(sz[2]) - sz[0];
+    const double det = e1x * e2y - e2x * e1y;
+
+    double zA = 0.0, zB = 0.0;
+    if (det != 0.0)
+    {
+        zA = (e1z * e2y - e2z * e1y) / det;
+        zB = (e2z * e1x - e1z * e2x) / det;
+    }
+
+    rt.zA = float(zA);
+    rt.zB = float(zB);
+    rt.zC = float(sz[0] - zA * sx[0] - zB * sy[0]);
+
+    // two-sided: the back side of a triangle is lit with its normal turned around
+    rt.normal[0] = flip ? -normal.x : normal.x;
+    rt.normal[1] = flip ? -normal.y : normal.y;
+    rt.normal[2] = flip ? -normal.z : normal.z;
+    rt.minX      = unsigned(sminX);
+    rt.minY      = unsigned(sminY);
+    rt.maxX      = unsigned(smaxX);
+    rt.maxY      = unsigned(smaxY);
+    rt.id        = uint32_t(id) | (flip ? RASTER_FLIPPED : 0u);
+    rt.coverage  = 0;
+
+    // sub-pixel triangles: decide coverage of the one or two samples here, the kernels
+    // then skip the block walk. Most cover no sample at all and are dropped
+    if ((smaxX - sminX) + (smaxY - sminY) <= 1)
+    {
+        rt.coverage = covers(rt, sminX, sminY) ? 1u : 0u;
+        if (smaxX != sminX || smaxY != sminY)
+        {
+            rt.coverage |= covers(rt, smaxX, smaxY) ? 2u : 0u;
+        }
+
+        if (0 == rt.coverage)
+        {
+            return;
+        }
+    }
+
+    const uint32_t index = static_cast<uint32_t>(view.triangles.size());
+    view.triangles.push_back(rt);
+
+    // binning
+    for (size_t ty = sminY / TILE_SIZE; ty <= smaxY / TILE_SIZE; ++ty)
+    {
+        for (size_t tx = sminX / TILE_SIZE; tx <= smaxX / TILE_SIZE; ++tx)
+        {
+            view.bins[ty * m_tilesX + tx].push_back(index);
+        }
+    }
+}
+
+RasterTile RasterBackend::target(View& view, size_t tile, bool deferred)
+{
+    const size_t tx = tile % m_tilesX;
+    const size_t ty = tile / m_tilesX;
+
+    RasterTile target;
+    target.depth       = view.zbuffer.tile(tx, ty);
+    target.ids         = deferred ? &view.ids[tile * TILE_SIZE * TILE_SIZE] : nullptr;
+    target.tileSize    = TILE_SIZE;
+    target.x0          = unsigned(tx * TILE_SIZE);
+    target.y0          = unsigned(ty * TILE_SIZE);
+    target.color       = view.pic->data();
+    target.colorStride = view.pic->stride();
+    target.colorDepth  = view.pic->depth();
+    target.width       = unsigned(m_width);
+    target.height      = unsigned(m_height);
+    target.blockFar    = view.zbuffer.blockFar(tx, ty);
+    target.blockStale  = view.zbuffer.blockStale(tx, ty);
+    target.blockOpen   = view.zbuffer.blockOpen(tx, ty);
+    target.tileFar     = view.zbuffer.tileFar(tx, ty);
+    target.tileStale   = view.zbuffer.tileStale(tx, ty);
+    target.counters    = &view.counters[tile];
+    return target;
+}
+
+void RasterBackend::rasterizeTile(View& view, size_t tile, bool deferred)
+{
+    const auto& bin = view.bins[tile];
+    if (bin.empty())
+    {
+        return;
+    }
+
+    const RasterTile target = this->target(view, tile, deferred);
+
+    if (!deferred)
+    {
+        for (uint32_t index : bin)
+        {
+            m_kernels.rasterize(view.triangles[index], target, view.shading);
+        }
+
+        return;
+    }
+
+    for (uint32_t index : bin)
+    {
+        m_kernels.rasterizeIds(view.triangles[index], view.triangles[index].id, target);
+    }
+}
@@ -17,8 +17,16 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #pragma once
 
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <glm/glm.hpp>
 #include "../backend_interface.h"
+#include "kernel.h"
+#include "thread_pool.h"
 #include "vec4.h"
+#include "zbuffer.h"
 
 // A rasterizer based on
 // https://www.scratchapixel.com/lessons/3d-basic-rendering/rasterization-practical-implementation
@@ -29,10 +37,157 @@ public:
     ~RasterBackend();
 
     int render(Picture& pic, const Mesh& mesh, const Vec3& view_pos);
+    int render(const std::vector<Picture*>& pics, const Mesh& mesh, const std::vector<Vec3>& view_pos);
+    int render(Picture& pic, const IndexedMesh& mesh, const Vec3& view_pos);
+    int render(const std::vector<Picture*>& pics, const IndexedMesh& mesh, const std::vector<Vec3>& view_pos);
+    int render(const std::vector<Picture*>& pics, const Mesh& mesh, const AABBox& aabb, const std::vector<Vec3>& view_pos);
+    int render(const std::vector<Picture*>& pics, const IndexedMesh& mesh, const AABBox& aabb, const std::vector<Vec3>& view_pos);
+
+    int begin(Picture& pic, const AABBox& aabb, const Vec3& view_pos);
+    int begin(const std::vector<Picture*>& pics, const AABBox& aabb, const std::vector<Vec3>& view_pos);
+    void draw(const Triangle* triangles, size_t count);
+    void end();
+
+    // the vertex transform stage of render(IndexedMesh) on its own, for benchmarks.
+    // Projects the vertices of mesh for the views set up by begin()
+    void transform(const IndexedMesh& mesh);
+
+    // threads used for rasterizing, 0 picks one per hardware thread
+    void setThreadCount(unsigned count);
+
+    // render() first resolves visibility and then shades every pixel once (default),
+    // instead of shading each fragment that passes the depth test. Streamed draw()
+    // calls always shade forward
+    void setDeferredShading(bool enable);
+
+    // render() draws the triangles of every view roughly front to back instead of in mesh
+    // order, so that the near ones fill the z-buffer first and the far ones fail the depth
+    // test early. Off by default. Triangles at exactly the same depth may then win a pixel
+    // in a different order
+    void setFrontToBack(bool enable);
+
+    // skip the triangles that face away from the camera (default). Only correct for closed
+    // meshes wound outwards, with it off every triangle is drawn from both sides and lit
+    // with its normal turned towards the camera
+    void setBackFaceCulling(bool enable);
+
+    // rounds the lighting to levels steps between black and full saturation of the model
+    // color, so the model gets at most levels + 1 colors (a palette PNG then holds the
+    // whole picture). 0 shades continuously (default)
+    void setShadingLevels(unsigned levels);
+
+    // asked between the triangle batches and screen tiles of render(), from the render
+    // threads. Once it returns true the rest is skipped and render() returns -1, the pictures
+    // are incomplete then. Empty by default
+    void setCancel(std::function<bool()> cancel);
+
+    // what the kernels did during the last render, summed over all views
+    RasterCounters counters() const;
+
+    // bytes render() allocates for views width x height views besides the pictures: per view
+    // the z-buffer, the ids, a full batch of set up triangles with its tile bins and the
+    // depth buckets. What grows with the mesh comes on top, see meshFootprint()
+    static size_t footprint(size_t width, size_t height, size_t views);
+
+    // bytes the views keep for a mesh: the projected vertices and, drawing front to back,
+    // the triangle order. They stay allocated for the next render of the backend
+    static size_t meshFootprint(size_t vertices, size_t triangles, size_t views, bool frontToBack);
+
+private:
+    static const size_t TILE_SIZE = ZBuffer::TILE_SIZE;
+
+    // triangles render() sets up at a time, bounds the per view buffers
+    static const size_t RENDER_BATCH_SIZE = 1 << 16;
+
+    // vertices per transform task
+    static const size_t TRANSFORM_CHUNK_SIZE = 1 << 14;
+
+    // the front to back order moves runs of DEPTH_CLUSTER_SIZE triangles, so neighbours in
+    // the mesh stay neighbours, sorted into DEPTH_BUCKETS depth slices
+    static const size_t DEPTH_CLUSTER_SIZE = 256;
+    static const size_t DEPTH_BUCKETS      = 1 << 12;
+
+    // a projected vertex: pixel coordinates and depth
+    struct ScreenVertex
+    {
+        float x;
+        float y;
+        float z;
+    };
+
+    // state of one view of the current render, set up by begin()
+    struct View
+    {
+        explicit View(size_t width, size_t height) : zbuffer(width, height)
+        {
+        }
+
+        Picture* pic = nullptr;
+        ZBuffer zbuffer;
+        glm::mat4x4 modelViewProj;
+        Vec3 viewPos;
+        RasterShading shading;
+
+        std::vector<uint32_t> ids;               // visibility buffer, laid out like the z-buffer tiles
+        std::vector<uint32_t> order;             // triangles in drawing order, empty for mesh order
+        std::vector<RasterCounters> counters;    // per screen tile
+        std::vector<ScreenVertex> vertices;      // the projected vertices of an IndexedMesh
+        std::vector<RasterTriangle> triangles;   // the current batch, projected
+        std::vector<std::vector<uint32_t>> bins; // per screen tile: indices into triangles, in submission order
+
+        // scratch space of sortFrontToBack
+        std::vector<float> clusterDepths;
+        std::vector<uint16_t> clusterBuckets;
+        std::vector<size_t> bucketStarts;
+    };
+
+    ThreadPool& pool();
+
+    // true once the cancel callback returned true during this render
+    bool cancelled();
+
+    // runs setup_batch(view) for every view and rasterizes the result
+    template <typename Setup>
+    void draw(const Setup& setup_batch, bool deferred);
+    void shade(const void* normals, size_t stride);
+
+    // fills view.order with triangles [0, count) sorted into depth buckets by cluster,
+    // nearest first. depth(i) is the summed vertex depth of triangle i
+    template <typename Depth>
+    void sortFrontToBack(View& view, size_t count, const Depth& depth);
+
+    ScreenVertex project(const View& view, const Vec3& v) const;
+    void clearBatch(View& view);
+    // set up the triangles [first, first + count) of view.order, or of the mesh if that is empty
+    void setup(View& view, const Triangle* triangles, size_t first, size_t count);
+    void setup(View& view, const IndexedMesh& mesh, size_t first, size_t count);
+    void setupTriangle(View& view, const ScreenVertex& v0, const ScreenVertex& v1, const ScreenVertex& v2, const Vec3& normal, size_t id);
+
+    RasterTile target(View& view, size_t tile, bool deferred);
+    void rasterizeTile(View& view, size_t tile, bool deferred);
 
 private:
     size_t m_width = 0;
     size_t m_height = 0;
+
+    size_t m_tilesX = 0;
+    size_t m_tilesY = 0;
+
+    std::vector<View> m_views; // kept between renders so the z-buffers are reused
+    size_t m_viewCount = 0;
+    std::vector<RasterTransform> m_transforms;
+
+    unsigned m_threadCount = 0;
+    std::unique_ptr<ThreadPool> m_pool;
+    RasterKernels m_kernels;
+    bool m_deferredShading = true;
+    bool m_frontToBack     = false;
+    bool m_backFaceCulling = true;
+    unsigned m_shadingLevels = 0;
+    RasterCounters m_counters = {};
+    std::function<bool()> m_cancel;
+    std::atomic<bool> m_cancelled{ false };
+
 //    size_t m_size        = 0;
     Vec3 m_modelColor      = { 0 / 255.f, 120 / 255.f, 255 / 255.f }; // 模型颜色，蓝色
 //    Vec3 m_modelColor      = { 254 / 255.f, 242 / 255.f, 58 / 255.f }; // 模型颜色，金色1
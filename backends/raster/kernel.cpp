@@ -0,0 +1,54 @@
+/*
+Copyright (C) 2017  Paul Kremer
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "kernel.h"
+#include <cstdlib>
+#include <cstring>
+
+RasterKernels selectRasterKernels()
+{
+    const char* forced = std::getenv("STL2THUMBNAIL_SIMD");
+
+    if (forced != nullptr && 0 == std::strcmp(forced, "scalar"))
+    {
+        return { rasterizeScalar, rasterizeIdsScalar, shadeTileScalar, transformScalar };
+    }
+
+#ifdef STL2THUMBNAIL_X86_KERNELS
+    __builtin_cpu_init();
+
+    const bool avx2  = __builtin_cpu_supports("avx2");
+    const bool sse41 = __builtin_cpu_supports("sse4.1");
+
+    if (forced != nullptr && 0 == std::strcmp(forced, "sse4.1") && sse41)
+    {
+        return { rasterizeSse41, rasterizeIdsSse41, shadeTileSse41, transformSse41 };
+    }
+
+    if (avx2)
+    {
+        return { rasterizeAvx2, rasterizeIdsAvx2, shadeTileAvx2, transformAvx2 };
+    }
+
+    if (sse41)
+    {
+        return { rasterizeSse41, rasterizeIdsSse41, shadeTileSse41, transformSse41 };
+    }
+#endif
+
+    return { rasterizeScalar, rasterizeIdsScalar, shadeTileScalar, transformScalar };
+}
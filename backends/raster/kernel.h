@@ -0,0 +1,155 @@
+/*
+Copyright (C) 2017  Paul Kremer
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// The per-pixel inner loop of the raster backend. It is compiled once per instruction set
+// (scalar, SSE4.1, AVX2) and the best one the CPU supports is picked at runtime.
+// Only plain data crosses this interface, so the ISA specific translation units never
+// share inline code with the rest of the program.
+
+// sub-pixel precision of the snapped vertex positions
+static const int RASTER_SUBPIXEL_BITS = 4;
+
+// triangles are traversed in blocks of RASTER_BLOCK_SIZE x RASTER_BLOCK_SIZE pixels
+static const unsigned RASTER_BLOCK_SIZE = 8;
+
+// a set up triangle. Pixel (x, y) is covered when all three edge functions
+// edgeA * x + edgeB * y + edgeC are >= 0, the top-left fill rule is folded into edgeC.
+// Only one winding yields a covered pixel, the other one is culled during setup.
+// A triangle whose bounding box holds one or two pixels is a splat: setup already decided
+// which of those samples it covers and the kernels only depth test and shade them
+struct RasterTriangle
+{
+    int64_t edgeC[3];
+    int32_t edgeA[3];
+    int32_t edgeB[3];
+    float zA; // depth plane z = zA * x + zB * y + zC
+    float zB;
+    float zC;
+    float normal[3];
+    unsigned minX; // pixel bounding box
+    unsigned minY;
+    unsigned maxX;
+    unsigned maxY;
+    uint32_t id;       // index of the source triangle, the id deferred shading records
+    unsigned coverage; // splats: bit 0 sample (minX, minY), bit 1 sample (maxX, maxY). 0 otherwise
+};
+
+// what the kernels did in one tile, see RasterBackend::counters
+struct RasterCounters
+{
+    uint64_t fragments;       // covered samples that were depth tested
+    uint64_t rejected;        // of those, the ones that failed the test
+    uint64_t culledTriangles; // triangles the hierarchical z rejected for the whole tile
+    uint64_t culledBlocks;    // and single blocks it rejected
+};
+
+// the part of the render targets a kernel call may touch
+struct RasterTile
+{
+    float* depth;       // TILE_SIZE x TILE_SIZE depths, row-major
+    uint32_t* ids;      // triangle ids, same layout as depth. Only used by deferred shading
+    unsigned tileSize;  // a multiple of RASTER_BLOCK_SIZE
+    unsigned x0;        // tile origin in pixels
+    unsigned y0;
+    unsigned char* color; // picture pixels, row-major
+    size_t colorStride;
+    int colorDepth;     // 3: rgb, 4: rgba
+    unsigned width;     // picture size
+    unsigned height;
+
+    // hierarchical z, see ZBuffer. No depth in a RASTER_BLOCK_SIZE block is farther than
+    // its blockFar (row-major), a stale block may have been written since and an open one
+    // still has pixels without depth. No blockFar is farther than tileFar, which is stale
+    // once one of them has been recomputed
+    float* blockFar;
+    unsigned char* blockStale;
+    unsigned char* blockOpen;
+    float* tileFar;
+    unsigned char* tileStale;
+
+    RasterCounters* counters; // of this tile, added to
+};
+
+// lighting parameters, see RasterBackend
+struct RasterShading
+{
+    float lightPos[3];
+    float viewPos[3];
+    float ambient[3];
+    float diffuse[3];
+    float spec[3];
+    float model[3];
+    float levelScale; // light levels per unit of intensity, 0: not quantized
+};
+
+// forward shading: depth test the triangle and shade the fragments that pass
+using RasterizeFn = void (*)(const RasterTriangle& t, const RasterTile& tile, const RasterShading& shading);
+
+// deferred shading: depth test the triangle and record id for the fragments that pass.
+// Once all triangles are in, every covered pixel of the tile is shaded once with the
+// normal of the triangle it ended up with.
+using RasterizeIdsFn = void (*)(const RasterTriangle& t, uint32_t id, const RasterTile& tile);
+// The normal of triangle id is the float[3] at normals + id * stride bytes, negated if the
+// id has RASTER_FLIPPED set
+using ShadeTileFn    = void (*)(const void* normals, size_t stride, const RasterTile& tile, const RasterShading& shading);
+
+// the model-view-projection of one view
+struct RasterTransform
+{
+    float matrix[16]; // column-major, like glm
+    float width;      // viewport size
+    float height;
+    float* out;       // x, y, z per vertex: pixel coordinates and depth
+};
+
+// projects the vertices [first, first + count) of an x, y, z per vertex array with every
+// transform, so the vertices are read once however many views there are
+using TransformFn = void (*)(const float* vertices, size_t first, size_t count, const RasterTransform* transforms, size_t transformCount);
+
+struct RasterKernels
+{
+    RasterizeFn rasterize;
+    RasterizeIdsFn rasterizeIds;
+    ShadeTileFn shadeTile;
+    TransformFn transform;
+};
+
+void rasterizeScalar(const RasterTriangle& t, const RasterTile& tile, const RasterShading& shading);
+void rasterizeIdsScalar(const RasterTriangle& t, uint32_t id, const RasterTile& tile);
+void shadeTileScalar(const void* normals, size_t stride, const RasterTile& tile, const RasterShading& shading);
+void transformScalar(const float* vertices, size_t first, size_t count, const RasterTransform* transforms, size_t transformCount);
+
+void rasterizeSse41(const RasterTriangle& t, const RasterTile& tile, const RasterShading& shading);
+void rasterizeIdsSse41(const RasterTriangle& t, uint32_t id, const RasterTile& tile);
+void shadeTileSse41(const void* normals, size_t stride, const RasterTile& tile, const RasterShading& shading);
+void transformSse41(const float* vertices, size_t first, size_t count, const RasterTransform* transforms, size_t transformCount);
+
+void rasterizeAvx2(const RasterTriangle& t, const RasterTile& tile, const RasterShading& shading);
+void rasterizeIdsAvx2(const RasterTriangle& t, uint32_t id, const RasterTile& tile);
+void shadeTileAvx2(const void* normals, size_t stride, const RasterTile& tile, const RasterShading& shading);
+void transformAvx2(const float* vertices, size_t first, size_t count, const RasterTransform* transforms, size_t transformCount);
+
+// set in a deferred id when the triangle is seen from behind and lit with the opposite normal
+static const uint32_t RASTER_FLIPPED = 0x80000000u;
+
+// the fastest kernels for this CPU. STL2THUMBNAIL_SIMD=scalar|sse4.1|avx2 overrides the choice
+RasterKernels selectRasterKernels();
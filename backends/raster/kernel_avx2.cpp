@@ -0,0 +1,98 @@
+/*
+Copyright (C) 2017  Paul Kremer
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// compiled with -mavx2, only called after a runtime CPU check
+
+#include "kernel.h"
+#include <immintrin.h>
+
+namespace
+{
+struct Avx2Lanes
+{
+    static const unsigned W = 8;
+
+    using F = __m256;
+    using M = __m256;
+    using I = __m256i;
+
+    static F set1(float v) { return _mm256_set1_ps(v); }
+    static F ramp(float base) { return _mm256_add_ps(_mm256_set1_ps(base), _mm256_setr_ps(0.f, 1.f, 2.f, 3.f, 4.f, 5.f, 6.f, 7.f)); }
+    static F load(const float* p) { return _mm256_loadu_ps(p); }
+    static void store(float* p, F v) { _mm256_storeu_ps(p, v); }
+
+    static F add(F a, F b) { return _mm256_add_ps(a, b); }
+    static F sub(F a, F b) { return _mm256_sub_ps(a, b); }
+    static F mul(F a, F b) { return _mm256_mul_ps(a, b); }
+    static F div(F a, F b) { return _mm256_div_ps(a, b); }
+    static F sqrt(F a) { return _mm256_sqrt_ps(a); }
+    static F neg(F a) { return _mm256_xor_ps(a, _mm256_set1_ps(-0.0f)); }
+
+    static M cmplt(F a, F b) { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+    static M cmple(F a, F b) { return _mm256_cmp_ps(a, b, _CMP_LE_OQ); }
+    static M cmpgt(F a, F b) { return _mm256_cmp_ps(a, b, _CMP_GT_OQ); }
+
+    static M mand(M a, M b) { return _mm256_and_ps(a, b); }
+    static bool any(M m) { return _mm256_movemask_ps(m) != 0; }
+    static unsigned bits(M m) { return static_cast<unsigned>(_mm256_movemask_ps(m)); }
+    static F select(M m, F a, F b) { return _mm256_blendv_ps(b, a, m); }
+
+    static I toInt(F v) { return _mm256_cvttps_epi32(v); }
+    static F toFloat(I v) { return _mm256_cvtepi32_ps(v); }
+
+    static I packRGBA(I r, I g, I b)
+    {
+        return _mm256_or_si256(_mm256_or_si256(r, _mm256_slli_epi32(g, 8)), _mm256_or_si256(_mm256_slli_epi32(b, 16), _mm256_set1_epi32(int32_t(0xff000000))));
+    }
+
+    static void storeI(int32_t* p, I v) { _mm256_storeu_si256(reinterpret_cast<__m256i*>(p), v); }
+    static I loadI(const int32_t* p) { return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)); }
+    static I selecti(M m, I a, I b) { return _mm256_blendv_epi8(b, a, _mm256_castps_si256(m)); }
+
+    static I seti(int32_t v) { return _mm256_set1_epi32(v); }
+    static I rampi(int32_t base, int32_t step) { return _mm256_add_epi32(_mm256_set1_epi32(base), _mm256_mullo_epi32(_mm256_set1_epi32(step), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7))); }
+    static I addi(I a, I b) { return _mm256_add_epi32(a, b); }
+    static M cmpge0(I v) { return _mm256_castsi256_ps(_mm256_cmpgt_epi32(v, _mm256_set1_epi32(-1))); }
+
+    static void blendPixels(unsigned char* p, I v, M m)
+    {
+        _mm256_maskstore_epi32(reinterpret_cast<int*>(p), _mm256_castps_si256(m), v);
+    }
+};
+} // namespace
+
+#include "kernel_impl.h"
+
+void rasterizeAvx2(const RasterTriangle& t, const RasterTile& tile, const RasterShading& shading)
+{
+    rasterizeImpl<Avx2Lanes>(t, tile, ShadeSink<Avx2Lanes>(t, tile, shading));
+}
+
+void rasterizeIdsAvx2(const RasterTriangle& t, uint32_t id, const RasterTile& tile)
+{
+    rasterizeImpl<Avx2Lanes>(t, tile, IdSink<Avx2Lanes>(id, tile));
+}
+
+void shadeTileAvx2(const void* normals, size_t stride, const RasterTile& tile, const RasterShading& shading)
+{
+    shadeTileImpl<Avx2Lanes>(static_cast<const char*>(normals), stride, tile, shading);
+}
+
+void transformAvx2(const float* vertices, size_t first, size_t count, const RasterTransform* transforms, size_t transformCount)
+{
+    transformImpl<Avx2Lanes>(vertices, first, count, transforms, transformCount);
+}
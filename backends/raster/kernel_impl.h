@@ -0,0 +1,657 @@
+/*
+Copyright (C) 2017  Paul Kremer
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Included by the kernel_*.cpp files only, after they have defined the lane type V:
+//
+//   V::W                      number of lanes
+//   V::F, V::M, V::I          float vector, lane mask, int32 vector
+//   set1, ramp, load, store   ramp(b) is { b, b + 1, .., b + W - 1 }
+//   add, sub, mul, div, sqrt, neg
+//   cmplt, cmple, cmpgt       lane masks
+//   mand, any, bits           mask and, any lane set, bit i = lane i
+//   select(m, a, b)           m ? a : b per lane
+//   toInt                     truncating conversion
+//   packRGBA(r, g, b)         r | g << 8 | b << 16 | 0xff << 24
+//   loadI, storeI, selecti    int32 lanes from / to memory, m ? a : b per lane
+//   seti, rampi, addi         int32 lanes, rampi(b, s) is { b, b + s, .., b + (W - 1) * s }
+//   cmpge0                    lane mask of int32 lanes >= 0
+//   blendPixels(p, v, m)      p[i] = m[i] ? v[i] : p[i] for W packed rgba pixels
+//
+// Everything here has internal linkage, so every ISA gets its own copy.
+// Coverage is decided with exact integer edge functions and the float arithmetic never
+// fuses multiply-adds, so all instantiations produce bit-identical pictures.
+
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+
+namespace
+{
+template <typename V>
+inline typename V::F stdMax(typename V::F a, typename V::F b) // std::max(a, b), including its NaN behaviour
+{
+    return V::select(V::cmplt(a, b), b, a);
+}
+
+template <typename V>
+inline typename V::F stdMin(typename V::F a, typename V::F b) // std::min(a, b)
+{
+    return V::select(V::cmplt(b, a), b, a);
+}
+
+template <typename V>
+inline typename V::I floatToByte(typename V::F v)
+{
+    v = stdMax<V>(V::set1(0.0f), stdMin<V>(v, V::set1(1.0f)));
+    return V::toInt(V::mul(v, V::set1(255.0f)));
+}
+
+// lighting of W fragments at normalized screen position (px, py, pz) with normal n
+template <typename V>
+inline void shadePixels(typename V::F px, typename V::F py, typename V::F pz, typename V::F nX, typename V::F nY, typename V::F nZ, const RasterShading& sh, typename V::I rgb[3])
+{
+    using F = typename V::F;
+
+    const F two  = V::set1(2.f);
+    const F zero = V::set1(0.0f);
+
+    const F lX = V::set1(sh.lightPos[0]), lY = V::set1(sh.lightPos[1]), lZ = V::set1(sh.lightPos[2]);
+    const F vX = V::set1(sh.viewPos[0]), vY = V::set1(sh.viewPos[1]), vZ = V::set1(sh.viewPos[2]);
+
+    // calculate lightning
+    // diffuse
+    const F sX = V::sub(lX, px), sY = V::sub(lY, py), sZ = V::sub(lZ, pz);
+    const F diff = stdMax<V>(zero, V::add(V::add(V::mul(nX, sX), V::mul(nY, sY)), V::mul(nZ, sZ)));
+
+    // specular
+    const F lLen = V::sqrt(V::add(V::add(V::mul(sX, sX), V::mul(sY, sY)), V::mul(sZ, sZ)));
+    const F iX = V::neg(V::div(sX, lLen)), iY = V::neg(V::div(sY, lLen)), iZ = V::neg(V::div(sZ, lLen));
+
+    const F dX = V::sub(vX, px), dY = V::sub(vY, py), dZ = V::sub(vZ, pz);
+    const F vLen = V::sqrt(V::add(V::add(V::mul(dX, dX), V::mul(dY, dY)), V::mul(dZ, dZ)));
+    const F wX = V::div(dX, vLen), wY = V::div(dY, vLen), wZ = V::div(dZ, vLen);
+
+    const F k  = V::mul(two, V::add(V::add(V::mul(nX, iX), V::mul(nY, iY)), V::mul(nZ, iZ)));
+    const F rX = V::sub(iX, V::mul(k, nX)), rY = V::sub(iY, V::mul(k, nY)), rZ = V::sub(iZ, V::mul(k, nZ));
+    const F spec = stdMax<V>(V::add(V::add(V::mul(wX, rX), V::mul(wY, rY)), V::mul(wZ, rZ)), zero);
+
+    // merge
+    for (int c = 0; c < 3; ++c)
+    {
+        const F diffColor = V::mul(diff, V::set1(sh.diffuse[c]));
+        const F specColor = V::mul(V::mul(spec, V::set1(sh.spec[c])), V::set1(0.7f));
+        F light           = V::add(V::add(V::set1(sh.ambient[c]), diffColor), specColor);
+
+        if (sh.levelScale > 0.0f)
+        {
+            // round to the nearest level, light is never negative
+            const F scale = V::set1(sh.levelScale);
+            light         = V::div(V::toFloat(V::toInt(V::add(V::mul(light, scale), V::set1(0.5f)))), scale);
+        }
+
+        rgb[c] = floatToByte<V>(V::mul(light, V::set1(sh.model[c])));
+    }
+}
+
+// writes the lanes of pass to the W pixels starting at (x, y)
+template <typename V>
+inline void writePixels(const RasterTile& tile, unsigned x, unsigned y, const typename V::I rgb[3], typename V::M pass)
+{
+    unsigned char* row = tile.color + y * tile.colorStride;
+
+    if (4 == tile.colorDepth && x + V::W <= tile.width)
+    {
+        V::blendPixels(row + x * 4, V::packRGBA(rgb[0], rgb[1], rgb[2]), pass);
+        return;
+    }
+
+    int32_t r[V::W], g[V::W], b[V::W];
+    V::storeI(r, rgb[0]);
+    V::storeI(g, rgb[1]);
+    V::storeI(b, rgb[2]);
+
+    const unsigned bits = V::bits(pass);
+    for (unsigned i = 0; i < V::W; ++i)
+    {
+        if (bits & (1u << i))
+        {
+            unsigned char* p = row + (x + i) * tile.colorDepth;
+            p[0]             = static_cast<unsigned char>(r[i]);
+            p[1]             = static_cast<unsigned char>(g[i]);
+            p[2]             = static_cast<unsigned char>(b[i]);
+
+            if (4 == tile.colorDepth)
+            {
+                p[3] = 255;
+            }
+        }
+    }
+}
+
+// forward shading: every fragment that passes the depth test is lit and written
+template <typename V>
+struct ShadeSink
+{
+    using F = typename V::F;
+    using M = typename V::M;
+    using I = typename V::I;
+
+    ShadeSink(const RasterTriangle& t, const RasterTile& tile, const RasterShading& sh)
+        : tile(tile), sh(sh), nX(V::set1(t.normal[0])), nY(V::set1(t.normal[1])), nZ(V::set1(t.normal[2]))
+    {
+    }
+
+    void operator()(unsigned x, unsigned y, F xs, F ny, F pz, M pass) const
+    {
+        // the fragment position is the sample position
+        const F px = V::mul(V::set1(2.f), V::sub(V::div(xs, V::set1(static_cast<float>(tile.width))), V::set1(0.5f)));
+
+        I rgb[3];
+        shadePixels<V>(px, ny, pz, nX, nY, nZ, sh, rgb);
+        writePixels<V>(tile, x, y, rgb, pass);
+    }
+
+    const RasterTile& tile;
+    const RasterShading& sh;
+    F nX, nY, nZ;
+};
+
+// visibility buffer: the fragments that pass the depth test only record their triangle
+template <typename V>
+struct IdSink
+{
+    using F = typename V::F;
+    using M = typename V::M;
+
+    IdSink(uint32_t id, const RasterTile& tile) : tile(tile), id(V::seti(static_cast<int32_t>(id)))
+    {
+    }
+
+    void operator()(unsigned x, unsigned y, F, F, F, M pass) const
+    {
+        int32_t* ids = reinterpret_cast<int32_t*>(tile.ids) + (y - tile.y0) * tile.tileSize + (x - tile.x0);
+        V::storeI(ids, V::selecti(pass, id, V::loadI(ids)));
+    }
+
+    const RasterTile& tile;
+    typename V::I id;
+};
+
+// the smallest of the lanes
+template <typename V>
+inline float farthest(typename V::F lanes)
+{
+    float values[V::W];
+    V::store(values, lanes);
+
+    float far = values[0];
+    for (unsigned i = 1; i < V::W; ++i)
+    {
+        far = values[i] < far ? values[i] : far;
+    }
+    return far;
+}
+
+// the nearest depth the plane of t has in pixels [x0, x1] x [y0, y1] as the kernels compute
+// it, rounded up by more than their rounding error
+inline float planeNear(const RasterTriangle& t, unsigned x0, unsigned y0, unsigned x1, unsigned y1)
+{
+    const double x   = t.zA > 0.0f ? x1 : x0;
+    const double y   = t.zB > 0.0f ? y1 : y0;
+    const double z   = double(t.zA) * x + double(t.zB) * y + double(t.zC);
+    const double err = (std::fabs(double(t.zA)) * x1 + std::fabs(double(t.zB)) * y1 + std::fabs(double(t.zC))) * 1e-6;
+    return static_cast<float>(z + err);
+}
+
+// true if near is not nearer than any depth of block b. A stale blockFar is recomputed
+// first, unless the block has open pixels and so no farthest depth yet
+template <typename V>
+inline bool blockBehind(const RasterTile& tile, unsigned b, float near)
+{
+    using F = typename V::F;
+    using M = typename V::M;
+
+    if (near <= tile.blockFar[b])
+    {
+        return true;
+    }
+
+    if (!tile.blockStale[b] || tile.blockOpen[b] > 0)
+    {
+        return false;
+    }
+
+    const unsigned B      = RASTER_BLOCK_SIZE;
+    const unsigned blocks = tile.tileSize / B;
+    const unsigned bx     = tile.x0 + b % blocks * B;
+    const unsigned by     = tile.y0 + b / blocks * B;
+    const unsigned x1     = bx + B < tile.width ? bx + B : tile.width;
+    const unsigned y1     = by + B < tile.height ? by + B : tile.height;
+
+    // depths are never NaN, so the order of the min does not matter
+    F lanes = V::set1(__builtin_inff());
+    for (unsigned y = by; y < y1; ++y)
+    {
+        const float* depthRow = tile.depth + (y - tile.y0) * tile.tileSize - tile.x0;
+        for (unsigned x = bx; x < x1; x += V::W)
+        {
+            // lanes right of the picture never get a depth
+            const M inside = V::cmplt(V::ramp(static_cast<float>(x)), V::set1(static_cast<float>(x1)));
+            lanes          = stdMin<V>(lanes, V::select(inside, V::load(depthRow + x), V::set1(__builtin_inff())));
+        }
+    }
+
+    const float far = farthest<V>(lanes);
+
+    tile.blockFar[b]   = far;
+    tile.blockStale[b] = 0;
+    *tile.tileStale    = 1;
+
+    return near <= far;
+}
+
+// true if near is not nearer than any depth of the tile. Only uses the block bounds as
+// they are, recomputing every stale block would cost more than it saves
+template <typename V>
+inline bool tileBehind(const RasterTile& tile, float near)
+{
+    using F = typename V::F;
+
+    if (near <= *tile.tileFar)
+    {
+        return true;
+    }
+
+    if (!*tile.tileStale)
+    {
+        return false;
+    }
+
+    const unsigned blocks = (tile.tileSize / RASTER_BLOCK_SIZE) * (tile.tileSize / RASTER_BLOCK_SIZE);
+
+    F lanes = V::set1(__builtin_inff());
+    for (unsigned b = 0; b < blocks; b += V::W)
+    {
+        lanes = stdMin<V>(lanes, V::load(tile.blockFar + b));
+    }
+
+    const float far = farthest<V>(lanes);
+
+    *tile.tileFar   = far;
+    *tile.tileStale = 0;
+
+    return near <= far;
+}
+
+// a splat: depth tests its covered samples one at a time, in the lane they would have in
+// the block walk, so the result is the same
+template <typename V, typename Sink>
+void splatImpl(const RasterTriangle& t, const RasterTile& tile, const Sink& sink)
+{
+    using F = typename V::F;
+    using M = typename V::M;
+
+    for (unsigned s = 0; s < 2; ++s)
+    {
+        const unsigned x = s ? t.maxX : t.minX;
+        const unsigned y = s ? t.maxY : t.minY;
+
+        if (!(t.coverage & (1u << s)) || x < tile.x0 || y < tile.y0 || x >= tile.x0 + tile.tileSize || y >= tile.y0 + tile.tileSize)
+        {
+            continue;
+        }
+
+        const unsigned base = x & ~(V::W - 1);
+        const F xs          = V::ramp(static_cast<float>(base));
+        const F sample      = V::set1(static_cast<float>(x));
+        const M lane        = V::mand(V::cmple(sample, xs), V::cmple(xs, sample));
+
+        const F ny = V::mul(V::set1(2.f), V::sub(V::div(V::set1(static_cast<float>(y)), V::set1(static_cast<float>(tile.height))), V::set1(0.5f)));
+        const F pz = V::add(V::mul(V::set1(t.zA), xs), V::set1(t.zB * static_cast<float>(y) + t.zC));
+
+        float* depth = tile.depth + (y - tile.y0) * tile.tileSize + (base - tile.x0);
+        const F old  = V::load(depth);
+        const M pass = V::mand(lane, V::cmpgt(pz, old));
+
+        tile.counters->fragments += 1;
+        if (!V::any(pass))
+        {
+            tile.counters->rejected += 1;
+            continue;
+        }
+
+        V::store(depth, V::select(pass, pz, old));
+
+        const unsigned block = (y - tile.y0) / RASTER_BLOCK_SIZE * (tile.tileSize / RASTER_BLOCK_SIZE) + (x - tile.x0) / RASTER_BLOCK_SIZE;
+        tile.blockOpen[block] -= static_cast<unsigned char>(__builtin_popcount(V::bits(V::mand(pass, V::cmple(old, V::set1(-__builtin_inff()))))));
+        tile.blockStale[block] = 1;
+
+        sink(base, y, xs, ny, pz, pass);
+    }
+}
+
+// depth tests the triangle against the tile and hands the passing fragments to the sink
+template <typename V, typename Sink>
+void rasterizeImpl(const RasterTriangle& t, const RasterTile& tile, const Sink& sink)
+{
+    using F = typename V::F;
+    using M = typename V::M;
+    using I = typename V::I;
+
+    if (t.coverage)
+    {
+        splatImpl<V>(t, tile, sink);
+        return;
+    }
+
+    // the part of the bounding box inside this tile
+    const unsigned x0 = t.minX > tile.x0 ? t.minX : tile.x0;
+    const unsigned y0 = t.minY > tile.y0 ? t.minY : tile.y0;
+    const unsigned x1 = t.maxX < tile.x0 + tile.tileSize - 1 ? t.maxX : tile.x0 + tile.tileSize - 1;
+    const unsigned y1 = t.maxY < tile.y0 + tile.tileSize - 1 ? t.maxY : tile.y0 + tile.tileSize - 1;
+
+    if (x0 > x1 || y0 > y1)
+    {
+        return;
+    }
+
+    // occluded by what the tile already holds
+    if (tileBehind<V>(tile, planeNear(t, x0, y0, x1, y1)))
+    {
+        tile.counters->culledTriangles += 1;
+        return;
+    }
+
+    const unsigned B      = RASTER_BLOCK_SIZE;
+    const unsigned blocks = tile.tileSize / B;
+
+    const F fHeight = V::set1(static_cast<float>(tile.height));
+    const F two     = V::set1(2.f);
+    const F half    = V::set1(0.5f);
+    const F first   = V::set1(static_cast<float>(x0));
+    const F last    = V::set1(static_cast<float>(x1));
+    const F zA      = V::set1(t.zA);
+    const F empty   = V::set1(-__builtin_inff());
+
+    // edge values of the W lanes relative to the first lane
+    I laneStep[3];
+    for (int k = 0; k < 3; ++k)
+    {
+        laneStep[k] = V::rampi(0, t.edgeA[k]);
+    }
+
+    RasterCounters counters = {};
+
+    // walk the 8x8 blocks covering the bounding box. Blocks are aligned to the tile, so
+    // every depth load and store stays inside the tile row
+    for (unsigned by = y0 & ~(B - 1); by <= y1; by += B)
+    {
+        for (unsigned bx = x0 & ~(B - 1); bx <= x1; bx += B)
+        {
+            // classify the block against the three edges using the corner where each
+            // edge function is smallest and largest
+            int32_t blockE[3];
+            int tests[3];
+            int testCount = 0;
+            bool outside  = false;
+
+            for (int k = 0; k < 3; ++k)
+            {
+                const int64_t a  = t.edgeA[k];
+                const int64_t b  = t.edgeB[k];
+                const int64_t e  = t.edgeC[k] + a * bx + b * by;
+                const int64_t lo = e + (a < 0 ? a : 0) * (B - 1) + (b < 0 ? b : 0) * (B - 1);
+                const int64_t hi = e + (a > 0 ? a : 0) * (B - 1) + (b > 0 ? b : 0) * (B - 1);
+
+                if (hi < 0)
+                {
+                    outside = true; // trivial reject
+                    break;
+                }
+
+                if (lo < 0)
+                {
+                    // the edge crosses the block, so |e| is bounded by the block size and
+                    // the per pixel values fit 32 bits
+                    blockE[testCount]  = static_cast<int32_t>(e);
+                    tests[testCount++] = k;
+                }
+            }
+
+            if (outside)
+            {
+                continue;
+            }
+
+            const unsigned colEnd = bx + B - 1 < x1 ? bx + B - 1 : x1;
+            const unsigned rowEnd = by + B - 1 < y1 ? by + B - 1 : y1;
+            const unsigned block  = (by - tile.y0) / B * blocks + (bx - tile.x0) / B;
+
+            if (blockBehind<V>(tile, block, planeNear(t, bx > x0 ? bx : x0, by > y0 ? by : y0, colEnd, rowEnd)))
+            {
+                counters.culledBlocks += 1;
+                continue;
+            }
+
+            bool written  = false;
+            unsigned open = tile.blockOpen[block];
+
+            for (unsigned y = by > y0 ? by : y0; y <= rowEnd; ++y)
+            {
+                // normalize screen coords [-1,1]
+                const F ny      = V::mul(two, V::sub(V::div(V::set1(static_cast<float>(y)), fHeight), half));
+                const F zRow    = V::set1(t.zB * static_cast<float>(y) + t.zC);
+                float* depthRow = tile.depth + (y - tile.y0) * tile.tileSize - tile.x0;
+
+                int32_t rowE[3];
+                for (int i = 0; i < testCount; ++i)
+                {
+                    rowE[i] = blockE[i] + t.edgeB[tests[i]] * static_cast<int32_t>(y - by);
+                }
+
+                for (unsigned x = bx; x < bx + B && x <= x1; x += V::W)
+                {
+                    if (x + V::W <= x0)
+                    {
+                        continue;
+                    }
+
+                    const F xs = V::ramp(static_cast<float>(x));
+
+                    M inside = V::mand(V::cmple(first, xs), V::cmple(xs, last));
+                    for (int i = 0; i < testCount; ++i)
+                    {
+                        const int k    = tests[i];
+                        const I values = V::addi(V::seti(rowE[i] + t.edgeA[k] * static_cast<int32_t>(x - bx)), laneStep[k]);
+                        inside         = V::mand(inside, V::cmpge0(values));
+                    }
+
+                    if (!V::any(inside))
+                    {
+                        continue;
+                    }
+
+                    // depth from the triangle's plane
+                    const F pz = V::add(V::mul(zA, xs), zRow);
+
+                    float* depth = depthRow + x;
+                    const F old  = V::load(depth);
+                    const M pass = V::mand(inside, V::cmpgt(pz, old));
+
+                    const unsigned covered = static_cast<unsigned>(__builtin_popcount(V::bits(inside)));
+                    const unsigned passed  = static_cast<unsigned>(__builtin_popcount(V::bits(pass)));
+                    counters.fragments += covered;
+                    counters.rejected += covered - passed;
+
+                    if (0 == passed)
+                    {
+                        continue;
+                    }
+
+                    V::store(depth, V::select(pass, pz, old));
+                    written = true;
+                    open -= static_cast<unsigned>(__builtin_popcount(V::bits(V::mand(pass, V::cmple(old, empty)))));
+
+                    sink(x, y, xs, ny, pz, pass);
+                }
+            }
+
+            if (written)
+            {
+                tile.blockStale[block] = 1;
+                tile.blockOpen[block]  = static_cast<unsigned char>(open);
+            }
+        }
+    }
+
+    tile.counters->fragments += counters.fragments;
+    tile.counters->rejected += counters.rejected;
+    tile.counters->culledBlocks += counters.culledBlocks;
+}
+
+// deferred shading: lights every covered pixel of the tile once, using the normal of the
+// triangle recorded in the visibility buffer
+template <typename V>
+void shadeTileImpl(const char* normals, size_t stride, const RasterTile& tile, const RasterShading& sh)
+{
+    using F = typename V::F;
+    using M = typename V::M;
+    using I = typename V::I;
+
+    const unsigned x1 = tile.x0 + tile.tileSize < tile.width ? tile.x0 + tile.tileSize : tile.width;
+    const unsigned y1 = tile.y0 + tile.tileSize < tile.height ? tile.y0 + tile.tileSize : tile.height;
+
+    const F fWidth  = V::set1(static_cast<float>(tile.width));
+    const F fHeight = V::set1(static_cast<float>(tile.height));
+    const F two     = V::set1(2.f);
+    const F half    = V::set1(0.5f);
+    const F last    = V::set1(static_cast<float>(x1 - 1));
+    const F empty   = V::set1(-__builtin_inff());
+
+    for (unsigned y = tile.y0; y < y1; ++y)
+    {
+        const F ny             = V::mul(two, V::sub(V::div(V::set1(static_cast<float>(y)), fHeight), half));
+        const float* depthRow  = tile.depth + (y - tile.y0) * tile.tileSize - tile.x0;
+        const uint32_t* idsRow = tile.ids + (y - tile.y0) * tile.tileSize - tile.x0;
+
+        for (unsigned x = tile.x0; x < x1; x += V::W)
+        {
+            const F xs   = V::ramp(static_cast<float>(x));
+            const F pz   = V::load(depthRow + x);
+            const M pass = V::mand(V::cmpgt(pz, empty), V::cmple(xs, last));
+
+            if (!V::any(pass))
+            {
+                continue;
+            }
+
+            // gather the normals of the visible triangles
+            float n[3][V::W] = {};
+            const unsigned bits = V::bits(pass);
+            for (unsigned i = 0; i < V::W; ++i)
+            {
+                if (bits & (1u << i))
+                {
+                    const uint32_t id   = idsRow[x + i];
+                    const float* normal = reinterpret_cast<const float*>(normals + (id & ~RASTER_FLIPPED) * stride);
+                    const float sign    = (id & RASTER_FLIPPED) ? -1.0f : 1.0f;
+                    n[0][i]             = sign * normal[0];
+                    n[1][i]             = sign * normal[1];
+                    n[2][i]             = sign * normal[2];
+                }
+            }
+
+            const F px = V::mul(two, V::sub(V::div(xs, fWidth), half));
+
+            I rgb[3];
+            shadePixels<V>(px, ny, pz, V::load(n[0]), V::load(n[1]), V::load(n[2]), sh, rgb);
+            writePixels<V>(tile, x, y, rgb, pass);
+        }
+    }
+}
+
+// projects vertices [first, first + count) with every transform. The vertices are read in
+// blocks, transposed to x, y and z arrays and transformed W at a time, in the operation
+// order of glm's mat4 * vec4 followed by the viewport mapping of RasterBackend
+template <typename V>
+void transformImpl(const float* vertices, size_t first, size_t count, const RasterTransform* transforms, size_t transformCount)
+{
+    using F = typename V::F;
+
+    const size_t BLOCK = 256;
+
+    float x[BLOCK], y[BLOCK], z[BLOCK];
+    float sx[BLOCK], sy[BLOCK], sz[BLOCK];
+
+    const F one = V::set1(1.0f);
+    const F two = V::set1(2.0f);
+
+    for (size_t begin = first; begin < first + count; begin += BLOCK)
+    {
+        const size_t n  = first + count - begin < BLOCK ? first + count - begin : BLOCK;
+        const float* in = vertices + 3 * begin;
+
+        for (size_t i = 0; i < n; ++i)
+        {
+            x[i] = in[3 * i];
+            y[i] = in[3 * i + 1];
+            z[i] = in[3 * i + 2];
+        }
+
+        // the last group may read past n, those lanes are never written out
+        for (size_t i = n; i < (n + V::W - 1) / V::W * V::W; ++i)
+        {
+            x[i] = y[i] = z[i] = 0.0f;
+        }
+
+        for (size_t v = 0; v < transformCount; ++v)
+        {
+            const RasterTransform& tr = transforms[v];
+            const float* m            = tr.matrix;
+
+            const F width  = V::set1(tr.width);
+            const F height = V::set1(tr.height);
+
+            for (size_t i = 0; i < n; i += V::W)
+            {
+                const F vx = V::load(x + i);
+                const F vy = V::load(y + i);
+                const F vz = V::load(z + i);
+
+                // (m[0] * x + m[1] * y) + (m[2] * z + m[3]), column by column
+                const F px = V::add(V::add(V::mul(V::set1(m[0]), vx), V::mul(V::set1(m[4]), vy)), V::add(V::mul(V::set1(m[8]), vz), V::set1(m[12])));
+                const F py = V::add(V::add(V::mul(V::set1(m[1]), vx), V::mul(V::set1(m[5]), vy)), V::add(V::mul(V::set1(m[9]), vz), V::set1(m[13])));
+                const F pz = V::add(V::add(V::mul(V::set1(m[2]), vx), V::mul(V::set1(m[6]), vy)), V::add(V::mul(V::set1(m[10]), vz), V::set1(m[14])));
+
+                // viewport: [-1,1] to [0,width]
+                V::store(sx + i, V::mul(V::div(V::add(px, one), two), width));
+                V::store(sy + i, V::mul(V::div(V::add(py, one), two), height));
+                V::store(sz + i, pz);
+            }
+
+            float* out = tr.out + 3 * begin;
+            for (size_t i = 0; i < n; ++i)
+            {
+                out[3 * i]     = sx[i];
+                out[3 * i + 1] = sy[i];
+                out[3 * i + 2] = sz[i];
+            }
+        }
+    }
+}
+} // namespace
@@ -0,0 +1,97 @@
+/*
+Copyright (C) 2017  Paul Kremer
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "kernel.h"
+
+namespace
+{
+// one pixel per lane, the reference the vector kernels have to match
+struct ScalarLanes
+{
+    static const unsigned W = 1;
+
+    using F = float;
+    using M = bool;
+    using I = int32_t;
+
+    static F set1(float v) { return v; }
+    static F ramp(float base) { return base; }
+    static F load(const float* p) { return *p; }
+    static void store(float* p, F v) { *p = v; }
+
+    static F add(F a, F b) { return a + b; }
+    static F sub(F a, F b) { return a - b; }
+    static F mul(F a, F b) { return a * b; }
+    static F div(F a, F b) { return a / b; }
+    static F sqrt(F a) { return __builtin_sqrtf(a); }
+    static F neg(F a) { return -a; }
+
+    static M cmplt(F a, F b) { return a < b; }
+    static M cmple(F a, F b) { return a <= b; }
+    static M cmpgt(F a, F b) { return a > b; }
+
+    static M mand(M a, M b) { return a && b; }
+    static bool any(M m) { return m; }
+    static unsigned bits(M m) { return m ? 1u : 0u; }
+    static F select(M m, F a, F b) { return m ? a : b; }
+
+    static I toInt(F v) { return static_cast<I>(v); }
+    static F toFloat(I v) { return static_cast<F>(v); }
+    static I packRGBA(I r, I g, I b) { return I(uint32_t(r) | uint32_t(g) << 8 | uint32_t(b) << 16 | 0xffu << 24); }
+    static void storeI(int32_t* p, I v) { *p = v; }
+    static I loadI(const int32_t* p) { return *p; }
+    static I selecti(M m, I a, I b) { return m ? a : b; }
+    static I seti(int32_t v) { return v; }
+    static I rampi(int32_t base, int32_t) { return base; }
+    static I addi(I a, I b) { return a + b; }
+    static M cmpge0(I v) { return v >= 0; }
+
+    static void blendPixels(unsigned char* p, I v, M m)
+    {
+        if (m)
+        {
+            const uint32_t u = uint32_t(v);
+            p[0]             = static_cast<unsigned char>(u);
+            p[1]             = static_cast<unsigned char>(u >> 8);
+            p[2]             = static_cast<unsigned char>(u >> 16);
+            p[3]             = static_cast<unsigned char>(u >> 24);
+        }
+    }
+};
+} // namespace
+
+#include "kernel_impl.h"
+
+void rasterizeScalar(const RasterTriangle& t, const RasterTile& tile, const RasterShading& shading)
+{
+    rasterizeImpl<ScalarLanes>(t, tile, ShadeSink<ScalarLanes>(t, tile, shading));
+}
+
+void rasterizeIdsScalar(const RasterTriangle& t, uint32_t id, const RasterTile& tile)
+{
+    rasterizeImpl<ScalarLanes>(t, tile, IdSink<ScalarLanes>(id, tile));
+}
+
+void shadeTileScalar(const void* normals, size_t stride, const RasterTile& tile, const RasterShading& shading)
+{
+    shadeTileImpl<ScalarLanes>(static_cast<const char*>(normals), stride, tile, shading);
+}
+
+void transformScalar(const float* vertices, size_t first, size_t count, const RasterTransform* transforms, size_t transformCount)
+{
+    transformImpl<ScalarLanes>(vertices, first, count, transforms, transformCount);
+}
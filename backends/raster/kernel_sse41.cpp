@@ -0,0 +1,99 @@
+/*
+Copyright (C) 2017  Paul Kremer
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// compiled with -msse4.1, only called after a runtime CPU check
+
+#include "kernel.h"
+#include <smmintrin.h>
+
+namespace
+{
+struct Sse41Lanes
+{
+    static const unsigned W = 4;
+
+    using F = __m128;
+    using M = __m128;
+    using I = __m128i;
+
+    static F set1(float v) { return _mm_set1_ps(v); }
+    static F ramp(float base) { return _mm_add_ps(_mm_set1_ps(base), _mm_setr_ps(0.f, 1.f, 2.f, 3.f)); }
+    static F load(const float* p) { return _mm_loadu_ps(p); }
+    static void store(float* p, F v) { _mm_storeu_ps(p, v); }
+
+    static F add(F a, F b) { return _mm_add_ps(a, b); }
+    static F sub(F a, F b) { return _mm_sub_ps(a, b); }
+    static F mul(F a, F b) { return _mm_mul_ps(a, b); }
+    static F div(F a, F b) { return _mm_div_ps(a, b); }
+    static F sqrt(F a) { return _mm_sqrt_ps(a); }
+    static F neg(F a) { return _mm_xor_ps(a, _mm_set1_ps(-0.0f)); }
+
+    static M cmplt(F a, F b) { return _mm_cmplt_ps(a, b); }
+    static M cmple(F a, F b) { return _mm_cmple_ps(a, b); }
+    static M cmpgt(F a, F b) { return _mm_cmpgt_ps(a, b); }
+
+    static M mand(M a, M b) { return _mm_and_ps(a, b); }
+    static bool any(M m) { return _mm_movemask_ps(m) != 0; }
+    static unsigned bits(M m) { return static_cast<unsigned>(_mm_movemask_ps(m)); }
+    static F select(M m, F a, F b) { return _mm_blendv_ps(b, a, m); }
+
+    static I toInt(F v) { return _mm_cvttps_epi32(v); }
+    static F toFloat(I v) { return _mm_cvtepi32_ps(v); }
+
+    static I packRGBA(I r, I g, I b)
+    {
+        return _mm_or_si128(_mm_or_si128(r, _mm_slli_epi32(g, 8)), _mm_or_si128(_mm_slli_epi32(b, 16), _mm_set1_epi32(int32_t(0xff000000))));
+    }
+
+    static void storeI(int32_t* p, I v) { _mm_storeu_si128(reinterpret_cast<__m128i*>(p), v); }
+    static I loadI(const int32_t* p) { return _mm_loadu_si128(reinterpret_cast<const __m128i*>(p)); }
+    static I selecti(M m, I a, I b) { return _mm_blendv_epi8(b, a, _mm_castps_si128(m)); }
+
+    static I seti(int32_t v) { return _mm_set1_epi32(v); }
+    static I rampi(int32_t base, int32_t step) { return _mm_add_epi32(_mm_set1_epi32(base), _mm_mullo_epi32(_mm_set1_epi32(step), _mm_setr_epi32(0, 1, 2, 3))); }
+    static I addi(I a, I b) { return _mm_add_epi32(a, b); }
+    static M cmpge0(I v) { return _mm_castsi128_ps(_mm_cmpgt_epi32(v, _mm_set1_epi32(-1))); }
+
+    static void blendPixels(unsigned char* p, I v, M m)
+    {
+        __m128i* dst = reinterpret_cast<__m128i*>(p);
+        _mm_storeu_si128(dst, _mm_blendv_epi8(_mm_loadu_si128(dst), v, _mm_castps_si128(m)));
+    }
+};
+} // namespace
+
+#include "kernel_impl.h"
+
+void rasterizeSse41(const RasterTriangle& t, const RasterTile& tile, const RasterShading& shading)
+{
+    rasterizeImpl<Sse41Lanes>(t, tile, ShadeSink<Sse41Lanes>(t, tile, shading));
+}
+
+void rasterizeIdsSse41(const RasterTriangle& t, uint32_t id, const RasterTile& tile)
+{
+    rasterizeImpl<Sse41Lanes>(t, tile, IdSink<Sse41Lanes>(id, tile));
+}
+
+void shadeTileSse41(const void* normals, size_t stride, const RasterTile& tile, const RasterShading& shading)
+{
+    shadeTileImpl<Sse41Lanes>(static_cast<const char*>(normals), stride, tile, shading);
+}
+
+void transformSse41(const float* vertices, size_t first, size_t count, const RasterTransform* transforms, size_t transformCount)
+{
+    transformImpl<Sse41Lanes>(vertices, first, count, transforms, transformCount);
+}
@@ -16,23 +16,91 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
 #include "zbuffer.h"
+#include <algorithm>
 #include <limits>
 
+// std::min takes it by reference
+const size_t ZBuffer::BLOCK_SIZE;
+
 ZBuffer::ZBuffer(size_t width, size_t height) : m_width(width), m_height(height)
 {
-    m_buffer.resize(m_width * m_height);
+    m_tilesX = (m_width + TILE_SIZE - 1) / TILE_SIZE;
+    m_tilesY = (m_height + TILE_SIZE - 1) / TILE_SIZE;
+    m_buffer.resize(m_tilesX * m_tilesY * TILE_SIZE * TILE_SIZE);
+    m_blockFar.resize(m_tilesX * m_tilesY * TILE_BLOCKS);
+    m_blockStale.resize(m_tilesX * m_tilesY * TILE_BLOCKS);
+    m_blockOpen.resize(m_tilesX * m_tilesY * TILE_BLOCKS);
+    m_tileFar.resize(m_tilesX * m_tilesY);
+    m_tileStale.resize(m_tilesX * m_tilesY);
+    m_clearBlockFar.resize(m_tilesX * m_tilesY * TILE_BLOCKS);
+    m_clearBlockOpen.resize(m_tilesX * m_tilesY * TILE_BLOCKS);
 
-    for (std::size_t i = 0; i < m_buffer.size(); ++i)
+    for (size_t b = 0; b < m_clearBlockOpen.size(); ++b)
     {
-        m_buffer[i] = -std::numeric_limits<float>::infinity();
+        const size_t tile   = b / TILE_BLOCKS;
+        const size_t blocks = TILE_SIZE / BLOCK_SIZE;
+        const size_t x      = tile % m_tilesX * TILE_SIZE + b % TILE_BLOCKS % blocks * BLOCK_SIZE;
+        const size_t y      = tile / m_tilesX * TILE_SIZE + b % TILE_BLOCKS / blocks * BLOCK_SIZE;
+        const size_t w      = x < m_width ? std::min(BLOCK_SIZE, m_width - x) : 0;
+        const size_t h      = y < m_height ? std::min(BLOCK_SIZE, m_height - y) : 0;
+
+        // a block outside the picture has no depth that could be nearer
+        m_clearBlockOpen[b] = static_cast<unsigned char>(w * h);
+        m_clearBlockFar[b]  = w * h > 0 ? -std::numeric_limits<float>::infinity() : std::numeric_limits<float>::infinity();
     }
+
+    clear();
+}
+
+size_t ZBuffer::footprint(size_t width, size_t height)
+{
+    const size_t tiles = ((width + TILE_SIZE - 1) / TILE_SIZE) * ((height + TILE_SIZE - 1) / TILE_SIZE);
+
+    // per block the far depth, stale flag and open count and the far depth and open count
+    // a clear restores, per tile the far depth and stale flag
+    const size_t block = 2 * sizeof(float) + 3 * sizeof(unsigned char);
+    return tiles * (TILE_SIZE * TILE_SIZE * sizeof(float) + TILE_BLOCKS * block + sizeof(float) + sizeof(unsigned char));
+}
+
+void ZBuffer::clear()
+{
+    for (size_t ty = 0; ty < m_tilesY; ++ty)
+    {
+        for (size_t tx = 0; tx < m_tilesX; ++tx)
+        {
+            clearTile(tx, ty);
+        }
+    }
+}
+
+void ZBuffer::clearTile(size_t tx, size_t ty)
+{
+    const size_t tile = ty * m_tilesX + tx;
+
+    // plain fills and copies, the compiler turns them into vector stores
+    std::fill_n(&m_buffer[tile * TILE_SIZE * TILE_SIZE], TILE_SIZE * TILE_SIZE, -std::numeric_limits<float>::infinity());
+    std::copy_n(&m_clearBlockFar[tile * TILE_BLOCKS], TILE_BLOCKS, &m_blockFar[tile * TILE_BLOCKS]);
+    std::copy_n(&m_clearBlockOpen[tile * TILE_BLOCKS], TILE_BLOCKS, &m_blockOpen[tile * TILE_BLOCKS]);
+    std::fill_n(&m_blockStale[tile * TILE_BLOCKS], TILE_BLOCKS, 0);
+
+    m_tileFar[tile]   = -std::numeric_limits<float>::infinity();
+    m_tileStale[tile] = 0;
 }
 
 bool ZBuffer::testAndSet(size_t x, size_t y, float z)
 {
-    if (z > m_buffer[y * m_width + x])
+    float& depth = tile(x / TILE_SIZE, y / TILE_SIZE)[(y % TILE_SIZE) * TILE_SIZE + x % TILE_SIZE];
+
+    if (z > depth)
     {
-        m_buffer[y * m_width + x] = z;
+        const size_t block = (y % TILE_SIZE) / BLOCK_SIZE * (TILE_SIZE / BLOCK_SIZE) + (x % TILE_SIZE) / BLOCK_SIZE;
+        if (-std::numeric_limits<float>::infinity() == depth)
+        {
+            blockOpen(x / TILE_SIZE, y / TILE_SIZE)[block] -= 1;
+        }
+
+        depth = z;
+        blockStale(x / TILE_SIZE, y / TILE_SIZE)[block] = 1;
         return true;
     }
 
@@ -17,19 +17,97 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #pragma once
 
+#include <cstddef>
 #include <vector>
 
+// depth buffer stored tile by tile: the TILE_SIZE x TILE_SIZE depths of a screen tile
+// are contiguous, so a tile being rasterized stays in the cache of its thread.
+// Larger depths are nearer.
+//
+// On top of the depths it keeps a two level hierarchical z: the farthest depth of every
+// BLOCK_SIZE x BLOCK_SIZE block and of every tile. A triangle that is nowhere nearer than
+// that cannot pass a single depth test there. The far values are lower bounds that may
+// lag behind the depths: writes only flag a block stale and count the pixels it still has
+// without any depth. A block is recomputed once it has none left and a test against the
+// old value fails. Only pixels inside the picture count
 class ZBuffer
 {
 public:
+    static const size_t TILE_SIZE   = 64;
+    static const size_t BLOCK_SIZE  = 8;
+    static const size_t TILE_BLOCKS = (TILE_SIZE / BLOCK_SIZE) * (TILE_SIZE / BLOCK_SIZE);
+
     explicit ZBuffer(size_t width, size_t height);
 
+    // bytes a width x height z-buffer allocates, the depths and the hierarchical z
+    static size_t footprint(size_t width, size_t height);
+
+    void clear();
+    // clear() for tile (tx, ty) alone, so the tiles can be cleared in parallel
+    void clearTile(size_t tx, size_t ty);
+
     bool testAndSet(size_t x, size_t y, float z);
 //    size_t size() const;
 
+    size_t tilesX() const
+    {
+        return m_tilesX;
+    }
+
+    size_t tilesY() const
+    {
+        return m_tilesY;
+    }
+
+    // row-major depths of tile (tx, ty)
+    float* tile(size_t tx, size_t ty)
+    {
+        return &m_buffer[(ty * m_tilesX + tx) * TILE_SIZE * TILE_SIZE];
+    }
+
+    // row-major farthest depths of the blocks of tile (tx, ty) and their stale flags
+    float* blockFar(size_t tx, size_t ty)
+    {
+        return &m_blockFar[(ty * m_tilesX + tx) * TILE_BLOCKS];
+    }
+
+    unsigned char* blockStale(size_t tx, size_t ty)
+    {
+        return &m_blockStale[(ty * m_tilesX + tx) * TILE_BLOCKS];
+    }
+
+    // pixels of each block of tile (tx, ty) that have not been written yet
+    unsigned char* blockOpen(size_t tx, size_t ty)
+    {
+        return &m_blockOpen[(ty * m_tilesX + tx) * TILE_BLOCKS];
+    }
+
+    // farthest depth of tile (tx, ty), the farthest of its blockFar. Stale when one of
+    // those has been recomputed since
+    float* tileFar(size_t tx, size_t ty)
+    {
+        return &m_tileFar[ty * m_tilesX + tx];
+    }
+
+    unsigned char* tileStale(size_t tx, size_t ty)
+    {
+        return &m_tileStale[ty * m_tilesX + tx];
+    }
+
 private:
     size_t m_width = 0;
     size_t m_height = 0;
+    size_t m_tilesX = 0;
+    size_t m_tilesY = 0;
 //    size_t m_size = 0;
     std::vector<float> m_buffer;
+    std::vector<float> m_blockFar;
+    std::vector<unsigned char> m_blockStale;
+    std::vector<unsigned char> m_blockOpen;
+    std::vector<float> m_tileFar;
+    std::vector<unsigned char> m_tileStale;
+
+    // what clear() resets blockFar and blockOpen to, they depend on the picture edges
+    std::vector<float> m_clearBlockFar;
+    std::vector<unsigned char> m_clearBlockOpen;
 };
@@ -0,0 +1,336 @@
+/*
+Copyright (C) 2017  Paul Kremer
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "batch.h"
+#include <dirent.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cerrno>
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+#include "bounded_queue.h"
+#include "memory_budget.h"
+
+// a file to thumbnail and where its pictures go
+struct BatchInput
+{
+    std::string in;
+    std::string out;
+};
+
+// a parsed model on its way to the render stage
+struct ParsedModel
+{
+    RenderJob job;
+    IndexedMesh mesh;
+    stl::MeshStats stats;
+    size_t footprint = 0; // taken from the budget of the meshes
+};
+
+// rendered pictures on their way to the encode stage, the context goes back to the pool after
+struct RenderedModel
+{
+    RenderJob job;
+    RenderContext* context = nullptr;
+};
+
+static bool isStlFile(const std::string& name)
+{
+    if (name.size() < 4)
+    {
+        return false;
+    }
+
+    std::string ext = name.substr(name.size() - 4);
+    std::transform(ext.begin(), ext.end(), ext.begin(), [](char c) { return char(std::tolower(c)); });
+    return ".stl" == ext;
+}
+
+// the .stl files of the directory, sorted so that runs are repeatable
+static int listDirectory(const std::string& path, std::vector<std::string>& files)
+{
+    DIR* dir = opendir(path.c_str());
+    if (nullptr == dir)
+    {
+        return -1;
+    }
+
+    while (const dirent* entry = readdir(dir))
+    {
+        if (!isStlFile(entry->d_name))
+        {
+            continue;
+        }
+
+        // links and filesystems that leave d_type open are asked what the entry is
+        const std::string file = path + "/" + entry->d_name;
+        struct stat status;
+        if (DT_REG == entry->d_type || ((DT_LNK == entry->d_type || DT_UNKNOWN == entry->d_type) && 0 == stat(file.c_str(), &status) && S_ISREG(status.st_mode)))
+        {
+            files.push_back(file);
+        }
+    }
+    closedir(dir);
+
+    std::sort(files.begin(), files.end());
+    return 0;
+}
+
+// the file name without .stl
+static std::string modelName(const std::string& file)
+{
+    const size_t slash = file.find_last_of('/');
+    std::string name   = file.substr(slash == std::string::npos ? 0 : slash + 1);
+    if (isStlFile(name))
+    {
+        name.resize(name.size() - 4);
+    }
+    return name;
+}
+
+// <dir>/<model name><extension of the format>. Models of the same name, from different
+// directories of a list or a.stl next to a.STL, get a_2, a_3, ... in the order they come
+static std::string outputPath(const std::string& dir, const std::string& file, ImageFormat format, std::unordered_set<std::string>& names)
+{
+    const std::string name = modelName(file);
+
+    std::string unique = name;
+    for (unsigned n = 2; !names.insert(unique).second; ++n)
+    {
+        unique = name + "_" + std::to_string(n);
+    }
+
+    return dir + "/" + unique + imageExtension(format);
+}
+
+// bytes a model takes until it is rendered: the indexed mesh and what the views keep for it
+static size_t modelFootprint(size_t vertices, size_t triangles, const RenderJob& job)
+{
+    const size_t views = std::max<size_t>(1, std::min(job.views, VIEW_POS.size()));
+    const size_t mesh  = vertices * sizeof(Vec3) + triangles * (3 * sizeof(uint32_t) + sizeof(Vec3));
+    return mesh + RasterBackend::meshFootprint(vertices, triangles, views, job.frontToBack);
+}
+
+// before parsing only the file size is known. Binary records are the densest, an ascii file
+// of the same size has fewer triangles. A closed mesh has about half as many vertices
+static size_t estimateFootprint(const std::string& file, const RenderJob& job)
+{
+    struct stat status;
+    if (stat(file.c_str(), &status) != 0)
+    {
+        return 0;
+    }
+
+    const size_t triangles = size_t(status.st_size) / 50;
+    return modelFootprint(triangles / 2, triangles, job);
+}
+
+template <typename Fn>
+static void startThreads(std::vector<std::thread>& threads, size_t count, const Fn& fn)
+{
+    for (size_t i = 0; i < count; ++i)
+    {
+        threads.emplace_back(fn);
+    }
+}
+
+static void joinThreads(std::vector<std::thread>& threads)
+{
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+    threads.clear();
+}
+
+int runBatch(const BatchOptions& options)
+{
+    std::vector<std::string> files;
+    if (options.input != "-" && listDirectory(options.input, files) != 0)
+    {
+        return -1;
+    }
+
+    if (mkdir(options.outputDir.c_str(), 0755) != 0 && errno != EEXIST)
+    {
+        return -1;
+    }
+
+    const size_t threads = options.threads > 0 ? options.threads : std::max(1u, std::thread::hardware_concurrency());
+
+    // two contexts per render thread, so a thread can render the next model while its last
+    // one is still being encoded. As many as fit half the memory, the renders that do not
+    // run side by side get the threads of the backend instead
+    const size_t footprint       = RenderContext::footprint(options.job.width, options.job.height, std::max<size_t>(1, std::min(options.job.views, VIEW_POS.size())));
+    const size_t contextCount    = std::max<size_t>(2, std::min(2 * threads, options.targetMemory / 2 / std::max<size_t>(1, footprint)));
+    const size_t renderCount     = contextCount / 2;
+    const unsigned renderThreads = unsigned(std::max<size_t>(1, threads / renderCount));
+
+    // the parsed meshes get what the contexts leave
+    const size_t contextMemory = contextCount * footprint;
+    MemoryBudget meshMemory(options.targetMemory > contextMemory ? options.targetMemory - contextMemory : 0);
+
+    // the stages hand over through these
+    BoundedQueue<BatchInput> inputs(4 * threads);
+    BoundedQueue<std::unique_ptr<ParsedModel>> parsed(renderCount);
+    BoundedQueue<RenderedModel> rendered(contextCount);
+    BoundedQueue<RenderContext*> freeContexts(contextCount);
+
+    std::vector<std::unique_ptr<RenderContext>> contexts(contextCount);
+    for (auto& context : contexts)
+    {
+        context.reset(new RenderContext);
+        RenderContext* free = context.get();
+        freeContexts.push(free);
+    }
+
+    std::atomic<int> failed(0);
+    std::atomic<int> written(0);
+    std::mutex logMutex;
+
+    auto fail = [&](const std::string& what, const std::string& file) {
+        failed += 1;
+        std::lock_guard<std::mutex> lock(logMutex);
+        std::cerr << what << " " << file << std::endl;
+    };
+
+    // stage 1: read and parse
+    auto parseStage = [&] {
+        stl::Parser parser;
+        parser.setThreadCount(1);
+
+        BatchInput input;
+        while (inputs.pop(input))
+        {
+            std::unique_ptr<ParsedModel> model(new ParsedModel);
+            model->job         = options.job;
+            model->job.in      = input.in;
+            model->job.threads = renderThreads;
+            setOutput(model->job, input.out);
+
+            // wait for the models before to be rendered when this one would not fit
+            const size_t estimate = estimateFootprint(input.in, model->job);
+            meshMemory.take(estimate);
+
+            if (loadMesh(parser, model->job, model->mesh, model->stats, nullptr) != 0)
+            {
+                meshMemory.give(estimate);
+                fail("Cannot parse file", input.in);
+                continue;
+            }
+
+            model->footprint = modelFootprint(model->mesh.vertices.size(), model->mesh.size(), model->job);
+            meshMemory.settle(estimate, model->footprint);
+
+            parsed.push(std::move(model));
+        }
+    };
+
+    // stage 2: render into a free context
+    auto renderStage = [&] {
+        std::unique_ptr<ParsedModel> model;
+        while (parsed.pop(model))
+        {
+            RenderContext* context = nullptr;
+            freeContexts.pop(context);
+
+            renderViews(*context, model->job, model->mesh, model->stats, nullptr);
+            rendered.push({ model->job, context });
+
+            const size_t taken = model->footprint;
+            model.reset();
+            meshMemory.give(taken);
+        }
+    };
+
+    // stage 3: encode, write and give the context back
+    auto encodeStage = [&] {
+        RenderedModel model;
+        while (rendered.pop(model))
+        {
+            if (savePictures(*model.context, model.job) != 0)
+            {
+                fail("Cannot write", model.job.out);
+            }
+            else
+            {
+                written += 1;
+            }
+
+            freeContexts.push(model.context);
+        }
+    };
+
+    const auto start = std::chrono::steady_clock::now();
+
+    std::vector<std::thread> parsers, renderers, encoders;
+    startThreads(parsers, threads, parseStage);
+    startThreads(renderers, renderCount, renderStage);
+    startThreads(encoders, std::min(threads, contextCount), encodeStage);
+
+    // the output names are handed out here, in input order, so no two models share one
+    std::unordered_set<std::string> names;
+    auto feed = [&](const std::string& file) {
+        inputs.push({ file, outputPath(options.outputDir, file, options.job.format, names) });
+    };
+
+    if (options.input == "-")
+    {
+        std::string line;
+        while (std::getline(std::cin, line))
+        {
+            if (!line.empty())
+            {
+                feed(line);
+            }
+        }
+    }
+    else
+    {
+        for (const auto& file : files)
+        {
+            feed(file);
+        }
+    }
+
+    // drain the stages one after the other
+    inputs.close();
+    joinThreads(parsers);
+    parsed.close();
+    joinThreads(renderers);
+    rendered.close();
+    joinThreads(encoders);
+
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    std::cout << "Thumbnails: " << written << " written, " << failed << " failed in " << elapsed.count() << " s";
+    if (elapsed.count() > 0.0)
+    {
+        std::cout << " (" << written / elapsed.count() << " files/s)";
+    }
+    std::cout << std::endl;
+
+    return failed;
+}
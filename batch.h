@@ -0,0 +1,45 @@
+/*
+Copyright (C) 2017  Paul Kremer
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#pragma once
+
+#include <string>
+#include "render_job.h"
+
+struct BatchOptions
+{
+    std::string input;     // a directory, its .stl files are rendered. "-" reads a list of files from stdin
+    std::string outputDir; // gets <name>.png or <name>-1.png, ... per model, after the model file name made unique
+    unsigned threads = 0;  // per stage, 0: one per hardware thread
+    RenderJob job;         // size, views, format and the other settings of every model
+
+    // bytes the models in flight may take together: half of it at most for the render
+    // targets, the rest for the parsed meshes. Large pictures get fewer render contexts, and
+    // with them fewer renders at a time that use more threads. Large meshes wait for the
+    // ones before them to be rendered before they are parsed
+    size_t targetMemory = size_t(2) << 30;
+};
+
+// Thumbnails many files in a pipeline of three stages joined by bounded queues: reading and
+// parsing, rendering, encoding and writing. Every stage has its own threads, so while one
+// model is encoded the next ones are already rendered and parsed. The queues and a fixed
+// set of render contexts, two per render thread and at most what fits targetMemory, bound
+// the models in flight. Every model takes its share of targetMemory before it is parsed and
+// gives it back once it is rendered, which bounds the memory of the meshes.
+// Returns the number of files that failed, -1 if the input cannot be read
+int runBatch(const BatchOptions& options);
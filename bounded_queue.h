@@ -0,0 +1,109 @@
+/*
+Copyright (C) 2017  Paul Kremer
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+// a fixed capacity FIFO between threads. Producers wait (push) or give up (tryPush) while
+// it is full, consumers wait while it is empty. After close() pushes fail and pop drains
+// what is left, then fails too
+template <typename T>
+class BoundedQueue
+{
+public:
+    explicit BoundedQueue(size_t capacity) : m_items(capacity > 0 ? capacity : 1)
+    {
+    }
+
+    BoundedQueue(const BoundedQueue&) = delete;
+    BoundedQueue& operator=(const BoundedQueue&) = delete;
+
+    bool push(T item)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_notFull.wait(lock, [this] { return m_closed || m_count < m_items.size(); });
+        return put(std::move(item));
+    }
+
+    // false without waiting when the queue is full, item is left alone then
+    bool tryPush(T& item)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_count == m_items.size())
+        {
+            return false;
+        }
+        return put(std::move(item));
+    }
+
+    bool pop(T& item)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_notEmpty.wait(lock, [this] { return m_closed || m_count > 0; });
+        if (0 == m_count)
+        {
+            return false;
+        }
+
+        item   = std::move(m_items[m_head]);
+        m_head = (m_head + 1) % m_items.size();
+        m_count -= 1;
+
+        m_notFull.notify_one();
+        return true;
+    }
+
+    void close()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_closed = true;
+        m_notFull.notify_all();
+        m_notEmpty.notify_all();
+    }
+
+private:
+    // with the lock held and room for one
+    bool put(T&& item)
+    {
+        if (m_closed)
+        {
+            return false;
+        }
+
+        m_items[(m_head + m_count) % m_items.size()] = std::move(item);
+        m_count += 1;
+
+        m_notEmpty.notify_one();
+        return true;
+    }
+
+private:
+    std::mutex m_mutex;
+    std::condition_variable m_notFull;
+    std::condition_variable m_notEmpty;
+
+    std::vector<T> m_items; // ring buffer
+    size_t m_head = 0;
+    size_t m_count = 0;
+    bool m_closed = false;
+};
@@ -0,0 +1,64 @@
+/*
+Copyright (C) 2017  Paul Kremer
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "cache_counter.h"
+
+#ifdef __linux__
+#include <cstring>
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+CacheCounter::CacheCounter()
+{
+#ifdef __linux__
+    perf_event_attr attr;
+    std::memset(&attr, 0, sizeof(attr));
+    attr.size           = sizeof(attr);
+    attr.type           = PERF_TYPE_HARDWARE;
+    attr.config         = PERF_COUNT_HW_CACHE_MISSES;
+    attr.inherit        = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv     = 1;
+
+    m_fd = int(syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0));
+#endif
+}
+
+CacheCounter::~CacheCounter()
+{
+#ifdef __linux__
+    if (m_fd >= 0)
+    {
+        close(m_fd);
+    }
+#endif
+}
+
+uint64_t CacheCounter::read() const
+{
+    uint64_t count = 0;
+#ifdef __linux__
+    if (m_fd >= 0 && ::read(m_fd, &count, sizeof(count)) != sizeof(count))
+    {
+        count = 0;
+    }
+#endif
+    return count;
+}
@@ -0,0 +1,46 @@
+/*
+Copyright (C) 2017  Paul Kremer
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#pragma once
+
+#include <cstdint>
+
+// counts the hardware cache misses of this process in user space, through perf_event_open on
+// Linux. Threads started after the counter was created add theirs once they have exited.
+// Where the counter is not available (other systems, perf_event_paranoid, containers)
+// valid() is false
+class CacheCounter
+{
+public:
+    CacheCounter();
+    ~CacheCounter();
+
+    CacheCounter(const CacheCounter&) = delete;
+    CacheCounter& operator=(const CacheCounter&) = delete;
+
+    bool valid() const
+    {
+        return m_fd >= 0;
+    }
+
+    // misses since the counter was created
+    uint64_t read() const;
+
+private:
+    int m_fd = -1;
+};
@@ -0,0 +1,158 @@
+/*
+Copyright (C) 2017  Paul Kremer
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+#include "args.hxx"
+#include "server_protocol.h"
+
+// Asks a running "stl2thumbnail --serve" for a thumbnail, with the arguments the
+// thumbnailer passes to stl2thumbnail itself:
+//   Exec=/usr/bin/stl2thumbnail-client -s %s %i %o
+// Without a server it runs stl2thumbnail, so thumbnails keep working either way
+
+// the renderer started when no server answers, looked up in PATH
+static const char* const RENDERER = "stl2thumbnail";
+
+// every request brings a deadline, so the wait for the reply follows from it: the server
+// stops parsing and rendering once it passed, writing the picture takes the grace
+static const unsigned DEFAULT_DEADLINE_MS = 30000;
+static const unsigned REPLY_GRACE_MS      = 2000;
+
+// the server runs in a directory of its own, relative paths are sent from ours
+static std::string absolutePath(const std::string& path)
+{
+    if (path.empty() || '/' == path[0])
+    {
+        return path;
+    }
+
+    char* cwd = getcwd(nullptr, 0);
+    if (nullptr == cwd)
+    {
+        return path;
+    }
+
+    const std::string absolute = std::string(cwd) + "/" + path;
+    free(cwd);
+    return absolute;
+}
+
+static int renderLocally(const std::string& size, unsigned views, const std::string& in, const std::string& out)
+{
+    const std::string viewCount = std::to_string(views);
+    execlp(RENDERER, RENDERER, "-s", size.c_str(), "--views", viewCount.c_str(), in.c_str(), out.c_str(), static_cast<char*>(nullptr));
+
+    std::cerr << "Cannot run " << RENDERER << std::endl;
+    return 1;
+}
+
+int main(int argc, char** argv)
+{
+    // command line
+    args::ArgumentParser parser("Creates thumbnails from STL files through a stl2thumbnail server", "");
+    args::HelpFlag help(parser, "help", "Display this help menu", { 'h', "help" });
+
+    args::Group group(parser, "This group is all exclusive:", args::Group::Validators::All);
+    args::Positional<std::string> in(group, "in", "The stl filename");
+    args::Positional<std::string> out(group, "out", "The thumbnail picture filename, the prefix with several views");
+    args::ValueFlag<std::string> picSize(group, "widthxheight", "The thumbnail size, a single number for a square", { 's' });
+    args::ValueFlag<unsigned> views(parser, "count", "Number of views, 1 to 4", { "views" }, 1);
+    args::ValueFlag<std::string> socketPath(parser, "path", "The socket of the server", { "socket" });
+    args::ValueFlag<unsigned> deadline(parser, "ms", "Milliseconds the server may take before the thumbnail is rendered here instead", { "deadline" }, DEFAULT_DEADLINE_MS);
+
+    try
+    {
+        parser.ParseCLI(argc, argv);
+    }
+    catch (args::Help)
+    {
+        std::cout << parser;
+        return 0;
+    }
+    catch (args::ParseError e)
+    {
+        std::cerr << e.what() << std::endl;
+        std::cerr << parser;
+        return 1;
+    }
+    catch (args::ValidationError)
+    {
+        std::cout << parser;
+        return 0;
+    }
+
+    ThumbnailRequest request;
+    request.in       = absolutePath(in.Get());
+    request.out      = absolutePath(out.Get());
+    request.views    = views.Get();
+    request.deadline = deadline.Get() > 0 ? deadline.Get() : DEFAULT_DEADLINE_MS;
+
+    std::string line;
+    if (!parsePictureSize(picSize.Get(), request.width, request.height) || !formatRequest(request, line))
+    {
+        std::cerr << "Cannot send the request" << std::endl;
+        return 1;
+    }
+
+    const int fd = connectSocket(socketPath ? socketPath.Get() : defaultSocketPath());
+    if (fd < 0)
+    {
+        return renderLocally(picSize.Get(), request.views, request.in, request.out);
+    }
+
+    const unsigned wait = request.deadline + REPLY_GRACE_MS;
+    timeval timeout     = { time_t(wait / 1000), suseconds_t(wait % 1000 * 1000) };
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+    // a server that turns us away answers without reading, so a failed send may still
+    // have a reply waiting
+    std::string reply;
+    writeAll(fd, line);
+    shutdown(fd, SHUT_WR);
+    const int ret = readLine(fd, reply, 4096);
+    close(fd);
+
+    // a server that hangs or goes away must not cost the thumbnail
+    if (ret != 0)
+    {
+        std::cerr << "No answer from the server" << std::endl;
+        return renderLocally(picSize.Get(), request.views, request.in, request.out);
+    }
+
+    if ("OK" == reply)
+    {
+        return 0;
+    }
+
+    std::cerr << reply << std::endl;
+
+    // the server cannot read or write the files, rendering here would fail the same way
+    if (0 == reply.compare(0, 5, "ERROR"))
+    {
+        return 1;
+    }
+
+    // BUSY, TIMEOUT or anything newer: the thumbnail is still wanted
+    return renderLocally(picSize.Get(), request.views, request.in, request.out);
+}
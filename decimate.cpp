@@ -0,0 +1,144 @@
+/*
+Copyright (C) 2017  Paul Kremer
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "decimate.h"
+#include <algorithm>
+
+// grid cells per pixel: two, so that a cell stays below a pixel from every direction
+static const float CELLS_PER_PIXEL = 2.0f;
+
+static uint64_t mix(uint64_t h)
+{
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdull;
+    h ^= h >> 33;
+    return h;
+}
+
+// neighbouring cells share a hash block of 4x4x4 slots, the vertices of a mesh come
+// roughly in surface order so most lookups stay in cache
+static size_t cellSlot(uint64_t cx, uint64_t cy, uint64_t cz)
+{
+    const uint64_t block = (cx >> 2) | (cy >> 2) << 21 | (cz >> 2) << 42;
+    return size_t(mix(block) << 6 | (cz & 3) << 4 | (cy & 3) << 2 | (cx & 3));
+}
+
+static size_t tableSize(size_t entries)
+{
+    size_t slots = 1024;
+    while (slots < entries * 2)
+    {
+        slots *= 2;
+    }
+    return slots;
+}
+
+float decimationCellSize(const AABBox& aabb, size_t width, size_t height)
+{
+    // the whole stride of the model fits the picture, see RasterBackend::begin
+    return aabb.stride() / (std::max(width, height) * CELLS_PER_PIXEL);
+}
+
+void decimate(const IndexedMesh& in, const AABBox& aabb, float cell_size, IndexedMesh& out)
+{
+    out.clear();
+
+    if (!(cell_size > 0.0f))
+    {
+        out = in;
+        return;
+    }
+
+    // cluster the vertices: cell coordinates -> cluster
+    const uint64_t CELL_MASK = (1u << 21) - 1; // 21 bits per axis
+    const uint64_t EMPTY     = ~uint64_t(0);
+
+    struct Slot
+    {
+        uint64_t cell;
+        uint32_t cluster;
+    };
+
+    std::vector<Slot> cells(tableSize(in.vertices.size()), Slot{ EMPTY, 0 });
+    std::vector<uint32_t> clusterOf(in.vertices.size());
+    std::vector<double> sums;
+    std::vector<uint32_t> counts;
+
+    const size_t cellMask = cells.size() - 1;
+
+    for (size_t i = 0; i < in.vertices.size(); ++i)
+    {
+        const Vec3& v = in.vertices[i];
+
+        const uint64_t cx = uint64_t(std::max(0.0f, (v.x - aabb.lower.x) / cell_size)) & CELL_MASK;
+        const uint64_t cy = uint64_t(std::max(0.0f, (v.y - aabb.lower.y) / cell_size)) & CELL_MASK;
+        const uint64_t cz = uint64_t(std::max(0.0f, (v.z - aabb.lower.z) / cell_size)) & CELL_MASK;
+        const uint64_t cell = cx | cy << 21 | cz << 42;
+
+        size_t slot = cellSlot(cx, cy, cz) & cellMask;
+        while (cells[slot].cell != EMPTY && cells[slot].cell != cell)
+        {
+            slot = (slot + 1) & cellMask;
+        }
+
+        if (cells[slot].cell == EMPTY)
+        {
+            cells[slot] = { cell, uint32_t(counts.size()) };
+            counts.push_back(0);
+            sums.insert(sums.end(), 3, 0.0);
+        }
+
+        const uint32_t cluster = cells[slot].cluster;
+        clusterOf[i]           = cluster;
+        counts[cluster] += 1;
+        sums[3 * cluster] += v.x;
+        sums[3 * cluster + 1] += v.y;
+        sums[3 * cluster + 2] += v.z;
+    }
+
+    std::vector<Slot>().swap(cells);
+
+    out.vertices.resize(counts.size());
+    for (size_t c = 0; c < counts.size(); ++c)
+    {
+        out.vertices[c] = { float(sums[3 * c] / counts[c]), float(sums[3 * c + 1] / counts[c]), float(sums[3 * c + 2] / counts[c]) };
+    }
+
+    // reconnect the triangles and drop the collapsed ones. The few that end up on top of
+    // each other are kept, finding them costs more than drawing them twice
+    out.indices.reserve(in.indices.size());
+    out.normals.reserve(in.size());
+
+    for (size_t t = 0; t < in.size(); ++t)
+    {
+        uint32_t idx[3] = { clusterOf[in.indices[3 * t]], clusterOf[in.indices[3 * t + 1]], clusterOf[in.indices[3 * t + 2]] };
+        if (idx[0] == idx[1] || idx[1] == idx[2] || idx[2] == idx[0])
+        {
+            continue;
+        }
+
+        out.indices.insert(out.indices.end(), idx, idx + 3);
+
+        // the facet normal of the merged triangle, the original one if it became too small
+        Triangle merged;
+        merged.vertices = { out.vertices[idx[0]], out.vertices[idx[1]], out.vertices[idx[2]] };
+
+        const Vec3 n = merged.calcNormal();
+        out.normals.push_back(n.length() > 0.0f ? n.normalize() : in.normals[t]);
+    }
+}
@@ -0,0 +1,31 @@
+/*
+Copyright (C) 2017  Paul Kremer
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#pragma once
+
+#include "aabb.h"
+#include "indexed_mesh.h"
+
+// Vertex clustering: the vertices are snapped to a grid of cell_size, every occupied cell
+// becomes one vertex at the average of its members and the triangles are reconnected to
+// those. Triangles that collapse to a line or a point are dropped.
+// Detail smaller than a cell disappears, the outline moves by less than a cell.
+void decimate(const IndexedMesh& in, const AABBox& aabb, float cell_size, IndexedMesh& out);
+
+// a cell size that keeps about the detail a width x height picture of the model can show
+float decimationCellSize(const AABBox& aabb, size_t width, size_t height);
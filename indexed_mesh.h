@@ -0,0 +1,53 @@
+/*
+Copyright (C) 2017  Paul Kremer
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "triangle.h"
+
+// a mesh that stores every distinct vertex once. Triangle i is made of the vertices
+// indices[3 * i], indices[3 * i + 1] and indices[3 * i + 2] and has the facet normal normals[i]
+struct IndexedMesh
+{
+    std::vector<Vec3> vertices;
+    std::vector<uint32_t> indices;
+    std::vector<Vec3> normals;
+
+    size_t size() const
+    {
+        return normals.size();
+    }
+
+    void clear()
+    {
+        vertices.clear();
+        indices.clear();
+        normals.clear();
+    }
+
+    Triangle triangle(size_t i) const
+    {
+        Triangle t;
+        t.vertices[0] = vertices[indices[3 * i]];
+        t.vertices[1] = vertices[indices[3 * i + 1]];
+        t.vertices[2] = vertices[indices[3 * i + 2]];
+        t.normal      = normals[i];
+        return t;
+    }
+};
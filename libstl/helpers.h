@@ -18,20 +18,190 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #pragma once
 
 #include <algorithm>
-#include <string>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
 
+// tokenizer helpers for ASCII stl files, all of them work in place on a [p, end) buffer
 namespace stl
 {
-void trim(std::string& s)
+inline bool isSpace(char c)
 {
-    s.erase(s.begin(), std::find_if(s.begin(), s.end(), [](int c) {
-        return !std::isspace(c);
-    }));
+    return ' ' == c || '\n' == c || '\r' == c || '\t' == c || '\v' == c || '\f' == c;
 }
 
-void getTrimmedLine(std::istream& in, std::string& out)
+inline void skipSpace(const char*& p, const char* end)
 {
-    std::getline(in, out);
-    trim(out);
+    while (p < end && isSpace(*p))
+    {
+        ++p;
+    }
+}
+
+inline void skipLine(const char*& p, const char* end)
+{
+    const char* nl = static_cast<const char*>(std::memchr(p, '\n', end - p));
+    p              = (nullptr == nl) ? end : nl + 1;
+}
+
+// matches the next token against keyword (len characters) and consumes it on success
+inline bool matchKeyword(const char*& p, const char* end, const char* keyword, size_t len)
+{
+    skipSpace(p, end);
+
+    if (size_t(end - p) < len || std::memcmp(p, keyword, len) != 0)
+    {
+        return false;
+    }
+
+    if (p + len < end && !isSpace(p[len]))
+    {
+        return false;
+    }
+
+    p += len;
+    return true;
+}
+
+// slow path for everything the fast path does not handle exactly (nan, inf, hex, long mantissas)
+inline bool parseFloatSlow(const char*& p, const char* token_end, float& v)
+{
+    char buf[128];
+    const size_t len = token_end - p;
+    if (0 == len || len >= sizeof(buf))
+    {
+        return false;
+    }
+
+    std::memcpy(buf, p, len);
+    buf[len] = '\0';
+
+    char* parsed_end = nullptr;
+    v                = std::strtof(buf, &parsed_end);
+    if (parsed_end != buf + len)
+    {
+        return false;
+    }
+
+    p = token_end;
+    return true;
+}
+
+// parses a decimal float token, giving the same (correctly rounded) result as sscanf("%e")
+inline bool parseFloat(const char*& p, const char* end, float& v)
+{
+    static const float FLOAT_POW10[] = { 1e0f, 1e1f, 1e2f, 1e3f, 1e4f, 1e5f, 1e6f, 1e7f, 1e8f, 1e9f, 1e10f };
+    static const double DOUBLE_POW10[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+                                           1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+
+    skipSpace(p, end);
+
+    const char* token_end = p;
+    while (token_end < end && !isSpace(*token_end))
+    {
+        ++token_end;
+    }
+
+    const char* s = p;
+    bool negative = false;
+    if (s < token_end && ('-' == *s || '+' == *s))
+    {
+        negative = ('-' == *s);
+        ++s;
+    }
+
+    uint64_t mantissa = 0;
+    int digits        = 0; // significant digits in mantissa
+    int exponent      = 0;
+    bool any_digit    = false;
+
+    for (; s < token_end && *s >= '0' && *s <= '9'; ++s)
+    {
+        any_digit = true;
+        if (digits > 0 || *s != '0')
+        {
+            mantissa = mantissa * 10 + (*s - '0');
+            ++digits;
+        }
+    }
+
+    if (s < token_end && '.' == *s)
+    {
+        for (++s; s < token_end && *s >= '0' && *s <= '9'; ++s)
+        {
+            any_digit = true;
+            if (digits > 0 || *s != '0')
+            {
+                mantissa = mantissa * 10 + (*s - '0');
+                ++digits;
+            }
+            --exponent;
+        }
+    }
+
+    if (s < token_end && ('e' == *s || 'E' == *s))
+    {
+        ++s;
+        bool exp_negative = false;
+        if (s < token_end && ('-' == *s || '+' == *s))
+        {
+            exp_negative = ('-' == *s);
+            ++s;
+        }
+
+        int e           = 0;
+        bool exp_digits = false;
+        for (; s < token_end && *s >= '0' && *s <= '9'; ++s)
+        {
+            exp_digits = true;
+            e          = std::min(e * 10 + (*s - '0'), 100000);
+        }
+
+        if (!exp_digits)
+        {
+            return parseFloatSlow(p, token_end, v);
+        }
+
+        exponent += exp_negative ? -e : e;
+    }
+
+    if (!any_digit || s != token_end || digits > 19)
+    {
+        return parseFloatSlow(p, token_end, v);
+    }
+
+    float result;
+    if (0 == mantissa)
+    {
+        result = 0.0f;
+    }
+    else if (mantissa <= (uint64_t(1) << 24) && exponent >= -10 && exponent <= 10)
+    {
+        // mantissa and power of ten are both exact floats, so a single rounding happens
+        result = exponent < 0 ? float(mantissa) / FLOAT_POW10[-exponent] : float(mantissa) * FLOAT_POW10[exponent];
+    }
+    else if (mantissa <= (uint64_t(1) << 53) && exponent >= -22 && exponent <= 22)
+    {
+        // correctly rounded double, then narrowed. Narrowing can only double-round when the
+        // double sits exactly halfway between two floats, leave those to strtof
+        double d = exponent < 0 ? double(mantissa) / DOUBLE_POW10[-exponent] : double(mantissa) * DOUBLE_POW10[exponent];
+
+        uint64_t bits;
+        std::memcpy(&bits, &d, sizeof(bits));
+        if ((bits & 0x1fffffff) == 0x10000000)
+        {
+            return parseFloatSlow(p, token_end, v);
+        }
+
+        result = float(d);
+    }
+    else
+    {
+        return parseFloatSlow(p, token_end, v);
+    }
+
+    v = negative ? -result : result;
+    p = token_end;
+    return true;
 }
 } // namespace
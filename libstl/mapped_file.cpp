@@ -0,0 +1,101 @@
+/*
+Copyright (C) 2017  Paul Kremer
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "mapped_file.h"
+#include <algorithm>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+namespace stl
+{
+MappedFile::MappedFile()
+{
+}
+
+MappedFile::~MappedFile()
+{
+    close();
+}
+
+int MappedFile::open(const std::string& file_path, bool populate)
+{
+    close();
+
+    int fd = ::open(file_path.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        return -1;
+    }
+
+    struct stat stat_buf;
+    if (fstat(fd, &stat_buf) != 0 || stat_buf.st_size <= 0)
+    {
+        ::close(fd);
+        return -1;
+    }
+
+    int flags = MAP_PRIVATE;
+#ifdef MAP_POPULATE
+    if (populate)
+    {
+        flags |= MAP_POPULATE;
+    }
+#endif
+
+    void* addr = mmap(nullptr, stat_buf.st_size, PROT_READ, flags, fd, 0);
+    ::close(fd); // the mapping keeps its own reference to the file
+
+    if (MAP_FAILED == addr)
+    {
+        return -1;
+    }
+
+    // the parsers walk the file front to back exactly once
+    madvise(addr, stat_buf.st_size, MADV_SEQUENTIAL);
+
+    m_data = static_cast<const char*>(addr);
+    m_size = stat_buf.st_size;
+
+    return 0;
+}
+
+void MappedFile::release(size_t offset, size_t length)
+{
+    const size_t page  = sysconf(_SC_PAGESIZE);
+    const size_t begin = (offset + page - 1) / page * page;
+    const size_t end   = std::min(offset + length, m_size) / page * page;
+
+    if (m_data != nullptr && begin < end)
+    {
+        madvise(const_cast<char*>(m_data) + begin, end - begin, MADV_DONTNEED);
+    }
+}
+
+void MappedFile::close()
+{
+    if (m_data != nullptr)
+    {
+        munmap(const_cast<char*>(m_data), m_size);
+    }
+
+    m_data = nullptr;
+    m_size = 0;
+}
+} // namespace
@@ -0,0 +1,96 @@
+/*
+Copyright (C) 2017  Paul Kremer
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "mesh_stats.h"
+#include <algorithm>
+#include <limits>
+
+#ifdef __SSE__
+#include <xmmintrin.h>
+#endif
+
+namespace stl
+{
+MeshStats::MeshStats()
+{
+    lower = { std::numeric_limits<float>::max(), std::numeric_limits<float>::max(), std::numeric_limits<float>::max() };
+    upper = { -std::numeric_limits<float>::max(), -std::numeric_limits<float>::max(), -std::numeric_limits<float>::max() };
+}
+
+static bool isDegenerate(const Triangle& t)
+{
+    const Vec3 n = t.calcNormal();
+    return 0.0f == n.x && 0.0f == n.y && 0.0f == n.z;
+}
+
+void MeshStats::add(const Triangle* tris, size_t count)
+{
+    for (size_t i = 0; i < count; ++i)
+    {
+        degenerate += isDegenerate(tris[i]);
+    }
+
+    triangles += count;
+
+#ifdef __SSE__
+    // one vertex per register, the 4th lane is ignored. The 4 float loads stay inside the
+    // triangle since the normal follows the vertices.
+    // min(v, lower) and max(v, upper) pick the same value as std::min / std::max
+    __m128 lo = _mm_setr_ps(lower.x, lower.y, lower.z, 0.0f);
+    __m128 hi = _mm_setr_ps(upper.x, upper.y, upper.z, 0.0f);
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        const float* v = &tris[i].vertices[0].x;
+
+        const __m128 v0 = _mm_loadu_ps(v);
+        const __m128 v1 = _mm_loadu_ps(v + 3);
+        const __m128 v2 = _mm_loadu_ps(v + 6);
+
+        lo = _mm_min_ps(v2, _mm_min_ps(v1, _mm_min_ps(v0, lo)));
+        hi = _mm_max_ps(v2, _mm_max_ps(v1, _mm_max_ps(v0, hi)));
+    }
+
+    float l[4], u[4];
+    _mm_storeu_ps(l, lo);
+    _mm_storeu_ps(u, hi);
+
+    lower = { l[0], l[1], l[2] };
+    upper = { u[0], u[1], u[2] };
+#else
+    for (size_t i = 0; i < count; ++i)
+    {
+        for (const Vec3& v : tris[i].vertices)
+        {
+            lower = { std::min(lower.x, v.x), std::min(lower.y, v.y), std::min(lower.z, v.z) };
+            upper = { std::max(upper.x, v.x), std::max(upper.y, v.y), std::max(upper.z, v.z) };
+        }
+    }
+#endif
+}
+
+void MeshStats::merge(const MeshStats& other)
+{
+    lower = { std::min(lower.x, other.lower.x), std::min(lower.y, other.lower.y), std::min(lower.z, other.lower.z) };
+    upper = { std::max(upper.x, other.upper.x), std::max(upper.y, other.upper.y), std::max(upper.z, other.upper.z) };
+
+    triangles += other.triangles;
+    degenerate += other.degenerate;
+    nanNormals += other.nanNormals;
+}
+} // namespace
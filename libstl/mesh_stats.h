@@ -0,0 +1,42 @@
+/*
+Copyright (C) 2017  Paul Kremer
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#pragma once
+
+#include <cstddef>
+#include "../triangle.h"
+
+namespace stl
+{
+// what the parser learns about the triangles while decoding them
+struct MeshStats
+{
+    MeshStats();
+
+    // counts the triangles and grows the bounds to include them
+    void add(const Triangle* triangles, size_t count);
+    void merge(const MeshStats& other);
+
+    Vec3 lower; // bounds of all vertices
+    Vec3 upper;
+    size_t triangles  = 0;
+    size_t degenerate = 0; // zero area
+    size_t nanNormals = 0; // NaN normal in the file, recalculated from the vertices
+    bool closed       = false; // watertight and wound outwards, see isClosed(). Only parseFile(IndexedMesh&) checks, streams have ClosedCheck
+};
+} // namespace
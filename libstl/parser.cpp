@@ -16,16 +16,89 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
 #include "parser.h"
-#include <sys/types.h>
-#include <sys/stat.h>
-#include <unistd.h>
-#include <fstream>
+#include <cmath>
+#include <cctype>
+#include <cstring>
+#include <thread>
+#include <vector>
 #include "helpers.h"
+#include "mapped_file.h"
+#include "mesh_stats.h"
+#include "topology.h"
+#include "welder.h"
 
 // STL format specifications: http://www.fabbers.com/tech/STL_Format
 
 namespace stl
 {
+static const size_t BINARY_HEADER_SIZE = 80; // 文件起始的80个字节是文件头，用于存贮零件名
+static const size_t BINARY_RECORD_SIZE = 50; // 每个三角面片占用固定的50个字节
+
+// below these amounts of work per thread, spawning threads costs more than it saves
+static const size_t MIN_BINARY_TRIANGLES_PER_THREAD = 1 << 16;
+static const size_t MIN_ASCII_BYTES_PER_THREAD      = 4 << 20;
+
+// triangles decoded at a time while welding
+static const size_t WELD_BATCH_SIZE = 1 << 16;
+
+// decoded triangles are added to the statistics in blocks that are still in the cache
+static const size_t STATS_BLOCK_SIZE = 1024;
+
+// runs fn(0) .. fn(count - 1), each on its own thread
+template <typename Fn>
+static void parallelFor(size_t count, Fn fn)
+{
+    std::vector<std::thread> threads;
+    threads.reserve(count);
+
+    for (size_t i = 1; i < count; ++i)
+    {
+        threads.emplace_back(fn, i);
+    }
+
+    fn(size_t(0));
+
+    for (auto& t : threads)
+    {
+        t.join();
+    }
+}
+
+// some stl files have garbage normals
+// we recalculate them here in case they are NaN
+static bool repairNormal(Triangle& triangle)
+{
+    if (std::isnan(triangle.normal.x) || std::isnan(triangle.normal.y) || std::isnan(triangle.normal.z))
+    {
+        triangle.normal = triangle.calcNormal().normalize();
+        return true;
+    }
+
+    return false;
+}
+
+// right behind the first "endfacet" at or after q, end if there is none
+static const char* facetBoundary(const char* q, const char* end)
+{
+    while (q < end)
+    {
+        q = static_cast<const char*>(memmem(q, end - q, "endfacet", 8));
+        if (nullptr == q)
+        {
+            return end;
+        }
+
+        if (isSpace(q[-1]) && (q + 8 == end || isSpace(q[8])))
+        {
+            return q + 8;
+        }
+
+        ++q;
+    }
+
+    return end;
+}
+
 Parser::Parser()
 {
 }
@@ -34,184 +107,572 @@ Parser::~Parser()
 {
 }
 
-int Parser::parseFile(Mesh& mesh, const std::string& file_path) const
+int Parser::parseFile(Mesh& mesh, const std::string& file_path, MeshStats* stats) const
 {
-    std::ifstream stream(file_path, std::ifstream::in | std::ifstream::binary);
-    if (!stream)
+    MappedFile file;
+    if (file.open(file_path, m_populate) != 0)
     {
 //        throw ("Cannot open file");
         return -1;
     }
 
-    if (isBinaryFormat(stream))
+    MeshStats fileStats;
+
+    int ret;
+    if (isBinaryFormat(file.data(), file.size()))
+    {
+        ret = parseBinary(mesh, file.data(), file.size(), fileStats);
+    }
+    else
+    {
+        ret = parseAscii(mesh, file.data(), file.size(), fileStats);
+    }
+
+    if (stats != nullptr)
+    {
+        *stats = fileStats;
+    }
+
+    return ret;
+}
+
+int Parser::parseFile(IndexedMesh& mesh, const std::string& file_path, MeshStats* stats, const CancelCallback& cancel) const
+{
+    MappedFile file;
+    if (file.open(file_path, m_populate) != 0)
+    {
+        return -1;
+    }
+
+    // decoded a few batches at a time, in parallel, and welded in file order. The triangles
+    // are never all decoded at once
+    Welder welder(mesh);
+    auto weld = [&](const Triangle* triangles, size_t count) {
+        if (cancel && cancel())
+        {
+            return -1;
+        }
+
+        welder.add(triangles, count);
+        return 0;
+    };
+
+    MeshStats fileStats;
+
+    int ret;
+    if (isBinaryFormat(file.data(), file.size()))
+    {
+        if (file.size() > BINARY_HEADER_SIZE + sizeof(uint32_t))
+        {
+            welder.reserve((file.size() - BINARY_HEADER_SIZE - sizeof(uint32_t)) / BINARY_RECORD_SIZE);
+        }
+
+        ret = parseBinaryBatches(file.data(), file.size(), weld, fileStats);
+    }
+    else
     {
-        struct stat stat_buf;
-        stat(file_path.c_str(), &stat_buf);
+        ret = parseAsciiBatches(file.data(), file.size(), weld, fileStats);
+    }
+
+    welder.finish();
 
-        return parseBinary(mesh, stream, stat_buf.st_size);
+    if (stats != nullptr)
+    {
+        *stats        = fileStats;
+        stats->closed = 0 == ret && isClosed(mesh);
     }
 
-    return parseAscii(mesh, stream);
+    return ret;
 }
 
-bool Parser::isBinaryFormat(std::ifstream& in) const
+int Parser::streamFile(const std::string& file_path, size_t batch_size, const BatchCallback& callback, MeshStats* stats) const
+{
+    // no MAP_POPULATE here, prefaulting would pull the whole file into memory at once
+    MappedFile file;
+    if (file.open(file_path) != 0 || 0 == batch_size)
+    {
+        return -1;
+    }
+
+    MeshStats fileStats;
+
+    int ret;
+    if (isBinaryFormat(file.data(), file.size()))
+    {
+        ret = streamBinary(file, batch_size, callback, fileStats);
+    }
+    else
+    {
+        ret = streamAscii(file, batch_size, callback, fileStats);
+    }
+
+    if (stats != nullptr)
+    {
+        *stats = fileStats;
+    }
+
+    return ret;
+}
+
+void Parser::setPopulate(bool populate)
+{
+    m_populate = populate;
+}
+
+void Parser::setThreadCount(unsigned count)
+{
+    m_threadCount = count;
+}
+
+size_t Parser::chunkCount(size_t work, size_t min_work_per_chunk) const
+{
+    size_t threads = (0 == m_threadCount) ? std::thread::hardware_concurrency() : m_threadCount;
+    return std::max<size_t>(1, std::min(threads, work / min_work_per_chunk));
+}
+
+bool Parser::isBinaryFormat(const char* data, size_t size) const
 {
     // Note: A file starting with "solid" is no indicator for having an ASCII file
     // Some exporters put "solid <name>" in the binary header
 
-    std::string line;
-    getTrimmedLine(in, line); // skip potential string: solid <name>
-    getTrimmedLine(in, line); // has to start with "facet" otherwise it is a binary file
+    // skip potential string: solid <name>
+    const char* end = data + size;
+    const char* p   = static_cast<const char*>(std::memchr(data, '\n', size));
+    if (nullptr == p)
+    {
+        return true;
+    }
 
-    // return to begin of file
-    in.clear();
-    in.seekg(0, in.beg);
+    // the second line has to start with "facet" otherwise it is a binary file
+    for (++p; p < end && '\n' != *p && std::isspace(static_cast<unsigned char>(*p)); ++p)
+    {
+    }
 
-    return line.substr(0, 5) != "facet";
+    return (end - p) < 5 || std::memcmp(p, "facet", 5) != 0;
 }
 
-int Parser::parseBinary(Mesh& mesh, std::ifstream& in, size_t file_size) const
+int Parser::parseBinary(Mesh& mesh, const char* data, size_t size, MeshStats& stats) const
 {
     // skip header
-    in.seekg(80); // 文件起始的80个字节是文件头，用于存贮零件名
+    if (size < BINARY_HEADER_SIZE + sizeof(uint32_t))
+    {
+        return -1;
+    }
 
     // get the number of triangles in the stl 紧接着用4个字节的整数来描述模型的三角面片个数
-    const uint32_t triangleCount = readU32(in);
-    if ((84 + 50 * triangleCount) != file_size)
+    uint32_t triangleCount;
+    std::memcpy(&triangleCount, data + BINARY_HEADER_SIZE, sizeof(triangleCount));
+    if ((BINARY_HEADER_SIZE + sizeof(uint32_t) + BINARY_RECORD_SIZE * uint64_t(triangleCount)) != size)
     {
         return -1;
     }
 
-    mesh.reserve(triangleCount); // 太大了内存可能会爆掉
+    const size_t first = mesh.size();
+    mesh.resize(first + triangleCount); // 太大了内存可能会爆掉
 
     // parse triangles 后面逐个给出每个三角面片的几何信息
-    size_t i;
+    decodeBinary(&mesh[first], data + BINARY_HEADER_SIZE + sizeof(uint32_t), triangleCount, stats);
 
-    for (i = 0; i < triangleCount && in; ++i)
-    {
-        Triangle triangle;
+    return 0;
+}
+
+void Parser::decodeBinary(Triangle* triangles, const char* records, size_t count, MeshStats& stats) const
+{
+    // records have a fixed size, so every thread decodes its own slice
+    const size_t chunks = chunkCount(count, MIN_BINARY_TRIANGLES_PER_THREAD);
+    std::vector<MeshStats> chunkStats(chunks);
+
+    parallelFor(chunks, [&](size_t chunk) {
+        const size_t begin = count * chunk / chunks;
+        const size_t end   = count * (chunk + 1) / chunks;
 
-        if (readBinaryTriangle(triangle, in) != 0)
+        const char* record = records + begin * BINARY_RECORD_SIZE;
+        for (size_t block = begin; block < end; block += STATS_BLOCK_SIZE)
         {
-            return -1;
+            const size_t blockEnd = std::min(end, block + STATS_BLOCK_SIZE);
+            for (size_t i = block; i < blockEnd; ++i, record += BINARY_RECORD_SIZE)
+            {
+                chunkStats[chunk].nanNormals += decodeBinaryTriangle(triangles[i], record);
+            }
+
+            chunkStats[chunk].add(&triangles[block], blockEnd - block);
         }
+    });
 
-        mesh.emplace_back(triangle);
+    for (const auto& s : chunkStats)
+    {
+        stats.merge(s);
     }
-
-    return 0;
 }
 
-int Parser::parseAscii(Mesh& mesh, std::ifstream& in) const
+int Parser::parseAscii(Mesh& mesh, const char* data, size_t size, MeshStats& stats) const
 {
+    const char* p   = data;
+    const char* end = data + size;
+
     // solid name
-    std::string line;
-    std::getline(in, line);
-    if (line.substr(0, 5) != "solid")
+    if (size < 5 || std::memcmp(p, "solid", 5) != 0)
     {
         return -1;
     }
 
-    while (in)
+    skipLine(p, end);
+
+    bool ended = false;
+    return parseAsciiChunks(mesh, p, end, ended, stats);
+}
+
+int Parser::parseAsciiChunks(Mesh& mesh, const char* p, const char* end, bool& ended, MeshStats& stats) const
+{
+    const size_t chunks = chunkCount(end - p, MIN_ASCII_BYTES_PER_THREAD);
+    if (1 == chunks)
+    {
+        return parseAsciiRange(mesh, p, end, ended, stats);
+    }
+
+    // split right behind an "endfacet" so that every chunk starts at a facet
+    std::vector<const char*> bounds(chunks + 1, end);
+    bounds[0] = p;
+
+    for (size_t i = 1; i < chunks; ++i)
+    {
+        bounds[i] = facetBoundary(std::max(bounds[i - 1], p + (end - p) * i / chunks), end);
+    }
+
+    std::vector<Mesh> parts(chunks);
+    std::vector<MeshStats> partStats(chunks);
+    std::vector<int> results(chunks, 0);
+    std::vector<char> chunkEnded(chunks, false);
+
+    parallelFor(chunks, [&](size_t chunk) {
+        bool chunk_ended = false;
+        results[chunk]    = parseAsciiRange(parts[chunk], bounds[chunk], bounds[chunk + 1], chunk_ended, partStats[chunk]);
+        chunkEnded[chunk] = chunk_ended;
+    });
+
+    // concatenate in file order, stopping at endsolid just like the serial parser does
+    size_t used  = 0;
+    size_t total = 0;
+    ended        = false;
+
+    for (; used < chunks; ++used)
+    {
+        if (results[used] != 0)
+        {
+            return -1;
+        }
+
+        total += parts[used].size();
+
+        if (chunkEnded[used])
+        {
+            ended = true;
+            ++used;
+            break;
+        }
+    }
+
+    mesh.reserve(mesh.size() + total);
+
+    for (size_t i = 0; i < used; ++i)
+    {
+        mesh.insert(mesh.end(), parts[i].begin(), parts[i].end());
+        Mesh().swap(parts[i]);
+        stats.merge(partStats[i]);
+    }
+
+    return 0;
+}
+
+int Parser::parseAsciiRange(Mesh& mesh, const char* p, const char* end, bool& ended, MeshStats& stats) const
+{
+    const size_t first = mesh.size();
+    size_t counted     = first;
+
+    ended = false;
+
+    while (true)
     {
         Triangle triangle;
 
-        if (readAsciiTriangle(triangle, in) != 0)
+        skipSpace(p, end);
+        if (p == end)
+        {
+            break; // 文件或者分块结束
+        }
+
+        const char* facet_begin = p;
+
+        int ret = readAsciiTriangle(triangle, p, end);
+        if (ret < 0)
         {
             return -1;
         }
+        else if (ret > 0)
+        {
+            ended = true; // endsolid
+            break;
+        }
 
+        if (mesh.size() == first)
+        {
+            // estimate the facet count from the size of the first facet,
+            // so that the mesh does not have to grow while parsing
+            mesh.reserve(first + (end - facet_begin) / std::max<size_t>(p - facet_begin, 1) + 1);
+        }
+
+        stats.nanNormals += repairNormal(triangle);
         mesh.emplace_back(triangle);
+
+        if (mesh.size() - counted == STATS_BLOCK_SIZE)
+        {
+            stats.add(&mesh[counted], STATS_BLOCK_SIZE);
+            counted = mesh.size();
+        }
     }
 
+    stats.add(mesh.data() + counted, mesh.size() - counted);
+
     return 0;
 }
 
-uint32_t Parser::readU32(std::ifstream& in) const
+int Parser::parseBinaryBatches(const char* data, size_t size, const BatchCallback& callback, MeshStats& stats) const
 {
-    uint32_t v;
-    in.read(reinterpret_cast<char*>(&v), sizeof(v));
-    return v;
+    if (size < BINARY_HEADER_SIZE + sizeof(uint32_t))
+    {
+        return -1;
+    }
+
+    uint32_t triangleCount;
+    std::memcpy(&triangleCount, data + BINARY_HEADER_SIZE, sizeof(triangleCount));
+    if ((BINARY_HEADER_SIZE + sizeof(uint32_t) + BINARY_RECORD_SIZE * uint64_t(triangleCount)) != size)
+    {
+        return -1;
+    }
+
+    // a batch for every thread at a time
+    const char* records     = data + BINARY_HEADER_SIZE + sizeof(uint32_t);
+    const size_t batch_size = chunkCount(triangleCount, MIN_BINARY_TRIANGLES_PER_THREAD) * WELD_BATCH_SIZE;
+    Mesh batch(std::min<size_t>(batch_size, triangleCount));
+
+    for (size_t begin = 0; begin < triangleCount; begin += batch_size)
+    {
+        const size_t count = std::min<size_t>(batch_size, triangleCount - begin);
+        decodeBinary(batch.data(), records + begin * BINARY_RECORD_SIZE, count, stats);
+
+        int ret = callback(batch.data(), count);
+        if (ret != 0)
+        {
+            return ret;
+        }
+    }
+
+    return 0;
 }
 
-uint16_t Parser::readU16(std::ifstream& in) const
+int Parser::parseAsciiBatches(const char* data, size_t size, const BatchCallback& callback, MeshStats& stats) const
 {
-    uint16_t v;
-    in.read(reinterpret_cast<char*>(&v), sizeof(v));
-    return v;
+    const char* p   = data;
+    const char* end = data + size;
+
+    // solid name
+    if (size < 5 || std::memcmp(p, "solid", 5) != 0)
+    {
+        return -1;
+    }
+
+    skipLine(p, end);
+
+    // MIN_ASCII_BYTES_PER_THREAD for every thread at a time, cut behind a facet
+    const size_t window = chunkCount(end - p, MIN_ASCII_BYTES_PER_THREAD) * MIN_ASCII_BYTES_PER_THREAD;
+    Mesh batch;
+
+    bool ended = false;
+    while (p < end && !ended)
+    {
+        const char* windowEnd = (size_t(end - p) > window) ? facetBoundary(p + window, end) : end;
+
+        batch.clear();
+        if (parseAsciiChunks(batch, p, windowEnd, ended, stats) != 0)
+        {
+            return -1;
+        }
+
+        if (!batch.empty())
+        {
+            int ret = callback(batch.data(), batch.size());
+            if (ret != 0)
+            {
+                return ret;
+            }
+        }
+
+        p = windowEnd;
+    }
+
+    return 0;
 }
 
-float Parser::readFloat(std::ifstream& in) const
+int Parser::streamBinary(MappedFile& file, size_t batch_size, const BatchCallback& callback, MeshStats& stats) const
 {
-    float v;
-    in.read(reinterpret_cast<char*>(&v), sizeof(v));
-    return v;
+    const char* data = file.data();
+    const size_t size = file.size();
+
+    if (size < BINARY_HEADER_SIZE + sizeof(uint32_t))
+    {
+        return -1;
+    }
+
+    uint32_t triangleCount;
+    std::memcpy(&triangleCount, data + BINARY_HEADER_SIZE, sizeof(triangleCount));
+    if ((BINARY_HEADER_SIZE + sizeof(uint32_t) + BINARY_RECORD_SIZE * uint64_t(triangleCount)) != size)
+    {
+        return -1;
+    }
+
+    const size_t records = BINARY_HEADER_SIZE + sizeof(uint32_t);
+    Mesh batch(std::min<size_t>(batch_size, triangleCount));
+
+    for (size_t begin = 0; begin < triangleCount; begin += batch_size)
+    {
+        const size_t count = std::min<size_t>(batch_size, triangleCount - begin);
+        const char* record = data + records + begin * BINARY_RECORD_SIZE;
+
+        for (size_t i = 0; i < count; ++i, record += BINARY_RECORD_SIZE)
+        {
+            stats.nanNormals += decodeBinaryTriangle(batch[i], record);
+        }
+
+        stats.add(batch.data(), count);
+
+        int ret = callback(batch.data(), count);
+        if (ret != 0)
+        {
+            return ret;
+        }
+
+        file.release(0, records + (begin + count) * BINARY_RECORD_SIZE);
+    }
+
+    return 0;
 }
 
-int Parser::readVector3(Vec3& v, std::ifstream& in) const
+int Parser::streamAscii(MappedFile& file, size_t batch_size, const BatchCallback& callback, MeshStats& stats) const
 {
-    v.x = readFloat(in);
-    v.y = readFloat(in);
-    v.z = -readFloat(in);
+    const char* data = file.data();
+    const char* p    = data;
+    const char* end  = data + file.size();
+
+    // solid name
+    if (file.size() < 5 || std::memcmp(p, "solid", 5) != 0)
+    {
+        return -1;
+    }
+
+    skipLine(p, end);
+
+    Mesh batch;
+    batch.reserve(batch_size);
+
+    while (true)
+    {
+        Triangle triangle;
+
+        int ret = readAsciiTriangle(triangle, p, end);
+        if (ret < 0)
+        {
+            return -1;
+        }
+
+        if (0 == ret)
+        {
+            stats.nanNormals += repairNormal(triangle);
+            batch.emplace_back(triangle);
+        }
+
+        if (batch.size() == batch_size || (ret > 0 && !batch.empty()))
+        {
+            stats.add(batch.data(), batch.size());
+
+            int cb_ret = callback(batch.data(), batch.size());
+            if (cb_ret != 0)
+            {
+                return cb_ret;
+            }
+
+            batch.clear();
+            file.release(0, p - data);
+        }
+
+        if (ret > 0)
+        {
+            break; // endsolid或者文件结束
+        }
+    }
 
     return 0;
 }
 
-int Parser::readAsciiTriangle(Triangle& triangle, std::ifstream& in) const
+int Parser::readAsciiTriangle(Triangle& triangle, const char*& p, const char* end) const
 {
-    std::string line;
-
-    getTrimmedLine(in, line);
-    int n = std::sscanf(line.c_str(), "facet normal %e %e %e", &triangle.normal.x, &triangle.normal.y, &triangle.normal.z);
-    if (n != 3)
+    if (!matchKeyword(p, end, "facet", 5))
     {
-        if (0 == line.length() || "endsolid" == line.substr(0, 8))
+        skipSpace(p, end);
+        if (p == end || matchKeyword(p, end, "endsolid", 8))
         {
-            // 要么是endpoint，要么是文件结束
-            return 0;
+            // 要么是endsolid，要么是文件结束
+            return 1;
         }
 
         return -1;
     }
 
-    getTrimmedLine(in, line); // outer loop
+    if (!matchKeyword(p, end, "normal", 6)
+        || !parseFloat(p, end, triangle.normal.x)
+        || !parseFloat(p, end, triangle.normal.y)
+        || !parseFloat(p, end, triangle.normal.z))
+    {
+        return -1;
+    }
+
+    if (!matchKeyword(p, end, "outer", 5) || !matchKeyword(p, end, "loop", 4))
+    {
+        return -1;
+    }
 
     for (size_t i = 0; i < 3; ++i)
     {
-        getTrimmedLine(in, line);
-        n = std::sscanf(line.c_str(), "vertex %e %e %e", &triangle.vertices[i].x, &triangle.vertices[i].y, &triangle.vertices[i].z);
-        if (n != 3)
+        if (!matchKeyword(p, end, "vertex", 6)
+            || !parseFloat(p, end, triangle.vertices[i].x)
+            || !parseFloat(p, end, triangle.vertices[i].y)
+            || !parseFloat(p, end, triangle.vertices[i].z))
         {
             return -1;
         }
     }
 
-    getTrimmedLine(in, line); // endloop
-    getTrimmedLine(in, line); // endfacet
+    if (!matchKeyword(p, end, "endloop", 7) || !matchKeyword(p, end, "endfacet", 8))
+    {
+        return -1;
+    }
 
     return 0;
 }
 
-int Parser::readBinaryTriangle(Triangle& triangle, std::ifstream& in) const
+bool Parser::decodeBinaryTriangle(Triangle& triangle, const char* record) const
 {
     // 每个三角面片占用固定的50个字节，依次是3个4字节浮点数(角面片的法矢量)，
     // 3个4字节浮点数(1个顶点的坐标)，3个4字节浮点数(2个顶点的坐标)，3个4字节浮点数(3个顶点的坐标)，
     // 最后2个字节用来描述三角面片的属性信息
-    readVector3(triangle.normal, in);
-    triangle.normal.normalize();
+    // records are packed, so the floats are loaded unaligned in one go
+    float v[12];
+    std::memcpy(v, record, sizeof(v));
 
-    readVector3(triangle.vertices[1], in);
-    readVector3(triangle.vertices[0], in);
-    readVector3(triangle.vertices[2], in);
-    readU16(in); // attributes
-
-    // some stl files have garbage normals
-    // we recalculate them here in case they are NaN
-    if (std::isnan(triangle.normal.x) || std::isnan(triangle.normal.y) || std::isnan(triangle.normal.z))
-    {
-        triangle.normal = triangle.calcNormal().normalize();
-    }
+    triangle.normal      = { v[0], v[1], -v[2] };
+    triangle.vertices[1] = { v[3], v[4], -v[5] };
+    triangle.vertices[0] = { v[6], v[7], -v[8] };
+    triangle.vertices[2] = { v[9], v[10], -v[11] };
 
-    return 0;
+    return repairNormal(triangle);
 }
 } // namespace
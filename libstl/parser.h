@@ -17,31 +17,74 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #pragma once
 
+#include <cstdint>
+#include <functional>
+#include <string>
+#include "../indexed_mesh.h"
 #include "../triangle.h"
 #include "../vec3.h"
 
 namespace stl
 {
+class MappedFile;
+struct MeshStats;
+
 class Parser
 {
 public:
+    // receives the next batch of triangles, a non-zero return value stops the stream
+    using BatchCallback = std::function<int(const Triangle* triangles, size_t count)>;
+    // true once the caller no longer wants the result
+    using CancelCallback = std::function<bool()>;
+
     Parser();
     ~Parser();
 
-    int parseFile(Mesh& triangles, const std::string& file_path) const;
+    // stats, if given, receive the bounds and counts collected while decoding
+    int parseFile(Mesh& triangles, const std::string& file_path, MeshStats* stats = nullptr) const;
+
+    // parses into a mesh that stores shared vertices once. cancel, if given, is asked between
+    // batches of triangles and stops the parse with -1
+    int parseFile(IndexedMesh& mesh, const std::string& file_path, MeshStats* stats = nullptr, const CancelCallback& cancel = nullptr) const;
+
+    // decodes the file in batches of at most batch_size triangles without building a Mesh.
+    // Consumed parts of the file are dropped from memory as the stream advances
+    int streamFile(const std::string& file_path, size_t batch_size, const BatchCallback& callback, MeshStats* stats = nullptr) const;
+
+    // prefault the whole file while mapping it, useful when the page cache is cold
+    void setPopulate(bool populate);
+
+    // number of threads used for large files, 0 picks one per hardware thread
+    void setThreadCount(unsigned count);
 
 private:
-    bool isBinaryFormat(std::ifstream& in) const;
+    bool isBinaryFormat(const char* data, size_t size) const;
+
+    int parseBinary(Mesh& mesh, const char* data, size_t size, MeshStats& stats) const;
+    int parseAscii(Mesh& mesh, const char* data, size_t size, MeshStats& stats) const;
+    // the facets between p and end, split into chunks that are parsed in parallel
+    int parseAsciiChunks(Mesh& mesh, const char* p, const char* end, bool& ended, MeshStats& stats) const;
+    int parseAsciiRange(Mesh& mesh, const char* p, const char* end, bool& ended, MeshStats& stats) const;
+    // count records into triangles, in parallel
+    void decodeBinary(Triangle* triangles, const char* records, size_t count, MeshStats& stats) const;
+
+    // like the stream functions, but every batch is decoded by all threads and the file stays
+    // mapped. What parseFile(IndexedMesh&) welds
+    int parseBinaryBatches(const char* data, size_t size, const BatchCallback& callback, MeshStats& stats) const;
+    int parseAsciiBatches(const char* data, size_t size, const BatchCallback& callback, MeshStats& stats) const;
 
-    int parseBinary(Mesh& mesh, std::ifstream& in, size_t file_size) const;
-    int parseAscii(Mesh& mesh, std::ifstream& in) const;
+    int streamBinary(MappedFile& file, size_t batch_size, const BatchCallback& callback, MeshStats& stats) const;
+    int streamAscii(MappedFile& file, size_t batch_size, const BatchCallback& callback, MeshStats& stats) const;
 
-    uint32_t readU32(std::ifstream& in) const;
-    uint16_t readU16(std::ifstream& in) const;
-    float readFloat(std::ifstream& in) const;
+    size_t chunkCount(size_t work, size_t min_work_per_chunk) const;
 
-    int readVector3(Vec3& vec, std::ifstream& in) const;
-    int readBinaryTriangle(Triangle& triangle, std::ifstream& in) const;
-    int readAsciiTriangle(Triangle& triangle, std::ifstream& in) const;
+    // true if the normal was NaN and got recalculated
+    bool decodeBinaryTriangle(Triangle& triangle, const char* record) const;
+    // 0: triangle read, 1: end of solid, -1: malformed facet
+    int readAsciiTriangle(Triangle& triangle, const char*& p, const char* end) const;
+
+private:
+    bool m_populate        = false;
+    unsigned m_threadCount = 0;
 };
 } // namespace
@@ -0,0 +1,166 @@
+/*
+Copyright (C) 2017  Paul Kremer
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "topology.h"
+#include <algorithm>
+#include <cstring>
+
+namespace stl
+{
+// six times the signed volume of the tetrahedron o, p0, p1, p2
+static double volume6(const Vec3& o, const Vec3& p0, const Vec3& p1, const Vec3& p2)
+{
+    const double ax = double(p0.x) - o.x, ay = double(p0.y) - o.y, az = double(p0.z) - o.z;
+    const double bx = double(p1.x) - o.x, by = double(p1.y) - o.y, bz = double(p1.z) - o.z;
+    const double cx = double(p2.x) - o.x, cy = double(p2.y) - o.y, cz = double(p2.z) - o.z;
+
+    return ax * (by * cz - bz * cy) + ay * (bz * cx - bx * cz) + az * (bx * cy - by * cx);
+}
+
+// of the bits, like the welder tells vertices apart
+static uint64_t hashVertex(const Vec3& v)
+{
+    uint32_t bits[3];
+    std::memcpy(bits, &v.x, sizeof(float));
+    std::memcpy(bits + 1, &v.y, sizeof(float));
+    std::memcpy(bits + 2, &v.z, sizeof(float));
+
+    uint64_t h = (uint64_t(bits[0]) | uint64_t(bits[1]) << 32) * 0x9e3779b97f4a7c15ull;
+    h ^= (h >> 29) + uint64_t(bits[2]) * 0xc2b2ae3d27d4eb4full;
+    h ^= h >> 32;
+    return h * 0xff51afd7ed558ccdull;
+}
+
+// of the directed edge a -> b, the edge b -> a gets the negated value
+static uint64_t hashEdge(uint64_t a, uint64_t b)
+{
+    auto mix = [](uint64_t x, uint64_t y) {
+        uint64_t h = x * 0xbf58476d1ce4e5b9ull + y;
+        h ^= h >> 31;
+        h *= 0x94d049bb133111ebull;
+        return h ^ (h >> 29);
+    };
+    return mix(a, b) - mix(b, a);
+}
+
+bool isClosed(const IndexedMesh& mesh)
+{
+    const size_t vertexCount = mesh.vertices.size();
+    if (mesh.size() == 0)
+    {
+        return false;
+    }
+
+    // triangles that use a vertex twice cover nothing and do not count
+    auto collapsed = [&](size_t t) {
+        const uint32_t* idx = &mesh.indices[3 * t];
+        return idx[0] == idx[1] || idx[1] == idx[2] || idx[2] == idx[0];
+    };
+
+    // the directed edges a -> b of every triangle, grouped by a
+    std::vector<uint32_t> starts(vertexCount + 1, 0);
+    for (size_t t = 0; t < mesh.size(); ++t)
+    {
+        if (!collapsed(t))
+        {
+            starts[mesh.indices[3 * t] + 1] += 1;
+            starts[mesh.indices[3 * t + 1] + 1] += 1;
+            starts[mesh.indices[3 * t + 2] + 1] += 1;
+        }
+    }
+
+    for (size_t v = 1; v <= vertexCount; ++v)
+    {
+        starts[v] += starts[v - 1];
+    }
+
+    std::vector<uint32_t> targets(starts[vertexCount]);
+    std::vector<uint32_t> fill(starts.begin(), starts.end() - 1);
+    for (size_t t = 0; t < mesh.size(); ++t)
+    {
+        if (collapsed(t))
+        {
+            continue;
+        }
+
+        const uint32_t* idx = &mesh.indices[3 * t];
+        for (int k = 0; k < 3; ++k)
+        {
+            targets[fill[idx[k]]++] = idx[(k + 1) % 3];
+        }
+    }
+
+    // every edge once in each direction. A vertex has few edges, a linear search is fine
+    for (size_t a = 0; a < vertexCount; ++a)
+    {
+        for (uint32_t e = starts[a]; e < starts[a + 1]; ++e)
+        {
+            const uint32_t b = targets[e];
+            if (std::count(&targets[starts[a]], &targets[starts[a + 1]], b) != 1 || std::count(&targets[starts[b]], &targets[starts[b + 1]], uint32_t(a)) != 1)
+            {
+                return false;
+            }
+        }
+    }
+
+    // consistently wound, but maybe inside out. Six times the volume, relative to a vertex
+    // of the mesh to keep the products small
+    const Vec3& o = mesh.vertices[0];
+
+    double volume = 0.0;
+    for (size_t t = 0; t < mesh.size(); ++t)
+    {
+        const Vec3& p0 = mesh.vertices[mesh.indices[3 * t]];
+        const Vec3& p1 = mesh.vertices[mesh.indices[3 * t + 1]];
+        const Vec3& p2 = mesh.vertices[mesh.indices[3 * t + 2]];
+
+        volume += volume6(o, p0, p1, p2);
+    }
+
+    return volume > 0.0;
+}
+
+void ClosedCheck::add(const Triangle* triangles, size_t count)
+{
+    for (size_t i = 0; i < count; ++i)
+    {
+        const Triangle& t = triangles[i];
+        if (m_empty)
+        {
+            m_origin = t.vertices[0]; // vertex 0 of the welded mesh
+            m_empty  = false;
+        }
+
+        // like isClosed() the volume includes collapsed triangles, the edges do not
+        m_volume += volume6(m_origin, t.vertices[0], t.vertices[1], t.vertices[2]);
+
+        const uint64_t h[] = { hashVertex(t.vertices[0]), hashVertex(t.vertices[1]), hashVertex(t.vertices[2]) };
+        if (h[0] == h[1] || h[1] == h[2] || h[2] == h[0])
+        {
+            continue;
+        }
+
+        m_edges += hashEdge(h[0], h[1]) + hashEdge(h[1], h[2]) + hashEdge(h[2], h[0]);
+    }
+}
+
+bool ClosedCheck::closed() const
+{
+    return !m_empty && 0 == m_edges && m_volume > 0.0;
+}
+} // namespace
@@ -0,0 +1,46 @@
+/*
+Copyright (C) 2017  Paul Kremer
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#pragma once
+
+#include "../indexed_mesh.h"
+
+namespace stl
+{
+// true if the mesh is watertight and wound outwards: every edge joins exactly two triangles
+// that run along it in opposite directions and the enclosed volume is positive. Only then
+// can a renderer skip the triangles that face away from it
+bool isClosed(const IndexedMesh& mesh);
+
+// isClosed() for triangles that are streamed instead of welded, in constant memory: add()
+// them in file order, then closed() tells. Instead of matching the edges it sums a hash
+// that cancels for every pair of opposite edges, so it also accepts edges shared by four
+// triangles, and an open mesh with a chance of 2^-64
+class ClosedCheck
+{
+public:
+    void add(const Triangle* triangles, size_t count);
+    bool closed() const;
+
+private:
+    bool m_empty     = true;
+    Vec3 m_origin;
+    uint64_t m_edges = 0; // sum of hashEdge() over all edges
+    double m_volume  = 0.0;
+};
+} // namespace
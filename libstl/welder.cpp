@@ -0,0 +1,133 @@
+/*
+Copyright (C) 2017  Paul Kremer
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "welder.h"
+#include <cstring>
+
+namespace stl
+{
+static uint32_t hashVertex(const Vec3& v)
+{
+    uint32_t bits[3];
+    std::memcpy(bits, &v.x, sizeof(float));
+    std::memcpy(bits + 1, &v.y, sizeof(float));
+    std::memcpy(bits + 2, &v.z, sizeof(float));
+
+    uint64_t h = (uint64_t(bits[0]) | uint64_t(bits[1]) << 32) * 0x9e3779b97f4a7c15ull;
+    h ^= (h >> 29) + uint64_t(bits[2]) * 0xc2b2ae3d27d4eb4full;
+    h ^= h >> 32;
+    return uint32_t(h);
+}
+
+static bool sameVertex(const Vec3& a, const Vec3& b)
+{
+    return 0 == std::memcmp(&a.x, &b.x, sizeof(float)) && 0 == std::memcmp(&a.y, &b.y, sizeof(float)) && 0 == std::memcmp(&a.z, &b.z, sizeof(float));
+}
+
+Welder::Welder(IndexedMesh& mesh) : m_mesh(mesh)
+{
+    rehash(1024);
+}
+
+void Welder::reserve(size_t triangles)
+{
+    // a closed mesh has about half as many vertices as triangles
+    m_mesh.vertices.reserve(m_mesh.vertices.size() + triangles / 2);
+    m_mesh.indices.reserve(m_mesh.indices.size() + triangles * 3);
+    m_mesh.normals.reserve(m_mesh.normals.size() + triangles);
+
+    size_t slots = m_table.size();
+    while (slots < m_mesh.vertices.capacity() * 2)
+    {
+        slots *= 2;
+    }
+
+    if (slots != m_table.size())
+    {
+        rehash(slots);
+    }
+}
+
+void Welder::add(const Triangle* triangles, size_t count)
+{
+    for (size_t i = 0; i < count; ++i)
+    {
+        const Triangle& t = triangles[i];
+
+        m_mesh.indices.push_back(vertex(t.vertices[0]));
+        m_mesh.indices.push_back(vertex(t.vertices[1]));
+        m_mesh.indices.push_back(vertex(t.vertices[2]));
+        m_mesh.normals.push_back(t.normal);
+    }
+}
+
+void Welder::finish()
+{
+    std::vector<uint32_t>().swap(m_table);
+
+    m_mesh.vertices.shrink_to_fit();
+    m_mesh.indices.shrink_to_fit();
+    m_mesh.normals.shrink_to_fit();
+}
+
+uint32_t Welder::vertex(const Vec3& v)
+{
+    const size_t mask = m_table.size() - 1;
+
+    for (size_t slot = hashVertex(v) & mask;; slot = (slot + 1) & mask)
+    {
+        const uint32_t entry = m_table[slot];
+        if (0 == entry)
+        {
+            const uint32_t index = uint32_t(m_mesh.vertices.size());
+            m_mesh.vertices.push_back(v);
+            m_table[slot] = index + 1;
+
+            // keep the table at most half full
+            if (m_mesh.vertices.size() * 2 > m_table.size())
+            {
+                rehash(m_table.size() * 2);
+            }
+
+            return index;
+        }
+
+        if (sameVertex(m_mesh.vertices[entry - 1], v))
+        {
+            return entry - 1;
+        }
+    }
+}
+
+void Welder::rehash(size_t slots)
+{
+    m_table.assign(slots, 0);
+
+    const size_t mask = slots - 1;
+    for (size_t i = 0; i < m_mesh.vertices.size(); ++i)
+    {
+        size_t slot = hashVertex(m_mesh.vertices[i]) & mask;
+        while (m_table[slot] != 0)
+        {
+            slot = (slot + 1) & mask;
+        }
+
+        m_table[slot] = uint32_t(i + 1);
+    }
+}
+} // namespace
@@ -0,0 +1,49 @@
+/*
+Copyright (C) 2017  Paul Kremer
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "../indexed_mesh.h"
+
+namespace stl
+{
+// builds an IndexedMesh from triangles, merging vertices with bit-identical positions
+class Welder
+{
+public:
+    explicit Welder(IndexedMesh& mesh);
+
+    // expected number of triangles, avoids regrowing the buffers
+    void reserve(size_t triangles);
+
+    void add(const Triangle* triangles, size_t count);
+
+    // drops the lookup table and trims the mesh buffers
+    void finish();
+
+private:
+    uint32_t vertex(const Vec3& v);
+    void rehash(size_t slots);
+
+private:
+    IndexedMesh& m_mesh;
+    std::vector<uint32_t> m_table; // open addressing, vertex index + 1, 0 is an empty slot
+};
+} // namespace
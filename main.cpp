@@ -15,12 +15,24 @@ You should have received a copy of the GNU General Public License
 along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include <algorithm>
+#include <chrono>
 #include <iostream>
+#include <zlib.h>
+#include <mesh_stats.h>
 #include <parser.h>
+#include <topology.h>
 
+#include "aabb.h"
 #include "args.hxx"
 #include "backends/raster/backend.h"
+#include "batch.h"
+#include "cache_counter.h"
 #include "picture.h"
+#include "render_context.h"
+#include "render_job.h"
+#include "server_protocol.h"
+#include "thumbnail_server.h"
 
 // mkdir build
 // cd build
@@ -29,16 +41,200 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 // ./stl2thumbnail ../hua.stl ./hua -s750x600
 // ./stl2thumbnail ../chaojisaiyaren.stl ./chaojisaiyaren -s750x600
 
+// triangles per batch in streaming mode, 64k triangles are 3MB
+static const size_t STREAM_BATCH_SIZE = 1 << 16;
+
+// "none", "sub", "up", "avg", "paeth" or "all" (adaptive)
+static int pngFilter(const std::string& name)
+{
+    const std::pair<const char*, int> FILTERS[] = {
+        { "none", PNG_FILTER_NONE }, { "sub", PNG_FILTER_SUB }, { "up", PNG_FILTER_UP },
+        { "avg", PNG_FILTER_AVG }, { "paeth", PNG_FILTER_PAETH }, { "all", PNG_ALL_FILTERS },
+    };
+
+    for (const auto& filter : FILTERS)
+    {
+        if (name == filter.first)
+        {
+            return filter.second;
+        }
+    }
+    return -1;
+}
+
+// "default", "filtered", "huffman" or "rle"
+static int pngStrategy(const std::string& name)
+{
+    const std::pair<const char*, int> STRATEGIES[] = {
+        { "default", Z_DEFAULT_STRATEGY }, { "filtered", Z_FILTERED }, { "huffman", Z_HUFFMAN_ONLY }, { "rle", Z_RLE },
+    };
+
+    for (const auto& strategy : STRATEGIES)
+    {
+        if (name == strategy.first)
+        {
+            return strategy.second;
+        }
+    }
+    return -1;
+}
+
+static std::vector<Picture*> pictureList(std::vector<Picture>& pics)
+{
+    std::vector<Picture*> list;
+    for (auto& pic : pics)
+    {
+        list.push_back(&pic);
+    }
+    return list;
+}
+
+// renders without ever holding the whole model in memory: one pass over the file
+// collects the bounding box, a second one streams the triangles through the backend
+static int renderStreaming(const stl::Parser& stlParser, const RenderJob& job)
+{
+    stl::MeshStats stats;
+    stl::ClosedCheck closedCheck;
+
+    int ret = stlParser.streamFile(job.in, STREAM_BATCH_SIZE, [&](const Triangle* triangles, size_t count) {
+        closedCheck.add(triangles, count);
+        return 0;
+    }, &stats);
+
+    if (ret != 0)
+    {
+        std::cerr << "Cannot parse file " << job.in << std::endl;
+        return 1;
+    }
+
+    stats.closed = closedCheck.closed();
+    printStats(std::cout, stats);
+
+    RenderContext context;
+    context.prepare(job.width, job.height, job.views);
+    const std::vector<Vec3> views(VIEW_POS.begin(), VIEW_POS.begin() + job.views);
+
+    // like renderViews(), a mesh that is not closed is drawn from both sides
+    RasterBackend& backend = context.backend();
+    backend.setThreadCount(job.threads);
+    backend.setBackFaceCulling(stats.closed);
+    backend.setShadingLevels(job.png.palette ? PALETTE_SHADING_LEVELS : 0);
+    backend.begin(context.pictures(), statsBounds(stats), views);
+
+    ret = stlParser.streamFile(job.in, STREAM_BATCH_SIZE, [&](const Triangle* triangles, size_t count) {
+        backend.draw(triangles, count);
+        return 0;
+    });
+
+    backend.end();
+    printCounters(std::cout, backend.counters());
+
+    if (ret != 0)
+    {
+        std::cerr << "Cannot parse file " << job.in << std::endl;
+        return 1;
+    }
+
+    return savePictures(context, job) != 0 ? 1 : 0;
+}
+
+// times the vertex transform stage of the raster backend on its own
+static int benchmarkTransform(const IndexedMesh& mesh, const AABBox& aabb, unsigned width, unsigned height, unsigned iterations, unsigned threads)
+{
+    RasterBackend backend(width, height);
+    backend.setThreadCount(threads);
+    std::vector<Picture> pics(VIEW_POS.size(), Picture(width, height));
+    backend.begin(pictureList(pics), aabb, VIEW_POS);
+
+    backend.transform(mesh); // warm up: thread pool, buffers
+
+    auto start = std::chrono::steady_clock::now();
+    for (unsigned i = 0; i < iterations; ++i)
+    {
+        backend.transform(mesh);
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    backend.end();
+
+    const double perPass  = elapsed.count() / iterations;
+    const double vertices = double(mesh.vertices.size()) * VIEW_POS.size();
+    std::cout << "Transform: " << perPass * 1000.0 << " ms per pass, " << vertices / perPass / 1e6 << " M vertices/s (" << VIEW_POS.size() << " views)" << std::endl;
+
+    return 0;
+}
+
+// times whole renders and counts their cache misses
+static int benchmarkRender(const IndexedMesh& mesh, const AABBox& aabb, bool closed, unsigned width, unsigned height, unsigned iterations, unsigned threads)
+{
+    // created before the render threads, so it sees them too once they are joined
+    CacheCounter counter;
+    std::chrono::duration<double> elapsed(0);
+    uint64_t misses = 0;
+
+    {
+        RenderContext context;
+        context.prepare(width, height, VIEW_POS.size());
+        context.backend().setThreadCount(threads);
+        context.backend().setBackFaceCulling(closed);
+
+        context.backend().render(context.pictures(), mesh, aabb, VIEW_POS); // warm up: thread pool, buffers
+        misses = counter.read();
+
+        auto start = std::chrono::steady_clock::now();
+        for (unsigned i = 0; i < iterations; ++i)
+        {
+            context.prepare(width, height, VIEW_POS.size());
+            context.backend().render(context.pictures(), mesh, aabb, VIEW_POS);
+        }
+        elapsed = std::chrono::steady_clock::now() - start;
+    }
+
+    std::cout << "Render: " << elapsed.count() / iterations * 1000.0 << " ms per pass";
+    if (counter.valid())
+    {
+        // the warm up misses of the worker threads are in here as well
+        std::cout << ", " << (counter.read() - misses) / iterations << " cache misses per pass";
+    }
+    else
+    {
+        std::cout << ", no cache miss counter";
+    }
+    std::cout << std::endl;
+
+    return 0;
+}
+
 int main(int argc, char** argv)
 {
     // command line
     args::ArgumentParser parser("Creates thumbnails from STL files", "");
     args::HelpFlag help(parser, "help", "Display this help menu", { 'h', "help" });
 
-    args::Group group(parser, "This group is all exclusive:", args::Group::Validators::All);
+    args::Group group(parser, "This group is all exclusive:", args::Group::Validators::AllOrNone);
     args::Positional<std::string> in(group, "in", "The stl filename");
-    args::Positional<std::string> out(group, "out", "The thumbnail picture filename prefix");
-    args::ValueFlag<std::string> picSize(group, "widthxheight", "The thumbnail size", { 's' });
+    args::Positional<std::string> out(group, "out", "The thumbnail picture filename prefix, with --views 1 the filename");
+    args::ValueFlag<std::string> picSize(group, "widthxheight", "The thumbnail size, a single number for a square", { 's' });
+    args::ValueFlag<unsigned> viewCount(parser, "count", "Number of views, 1 to 4", { "views" }, unsigned(VIEW_POS.size()));
+    args::ValueFlag<unsigned> threads(parser, "count", "Number of worker threads, 0 uses one per core", { 'j', "threads" }, 0);
+    args::Flag stream(parser, "stream", "Stream the stl file through the renderer instead of loading it (bounded memory)", { "stream" });
+    args::Flag populate(parser, "populate", "Prefault the whole stl file while mapping it (cold page cache)", { "populate" });
+    args::Flag frontToBack(parser, "front-to-back", "Draw the nearest triangles of every view first, so that hidden ones fail the depth test early", { "front-to-back" });
+    args::Flag decimateMesh(parser, "decimate", "Simplify the mesh to the detail the thumbnail size can show before rendering", { "decimate" });
+    args::Flag keepOrder(parser, "keep-order", "Render the triangles in file order, large meshes are sorted along a space-filling curve first otherwise", { "keep-order" });
+    args::ValueFlag<std::string> formatName(parser, "format", "Picture format: png (default), qoi, rgba (raw pixels) or ppm", { "format" });
+    args::ValueFlag<int> pngLevel(parser, "level", "zlib compression level of the pictures, 0 (fastest) to 9 (smallest)", { "png-level" });
+    args::ValueFlag<std::string> pngFilterName(parser, "filter", "PNG row filter: none, sub, up, avg, paeth or all (adaptive). By default none for palette pictures, all otherwise", { "png-filter" });
+    args::ValueFlag<std::string> pngStrategyName(parser, "strategy", "zlib strategy: default, filtered, huffman or rle", { "png-strategy" });
+    args::Flag palette(parser, "palette", "Round the shading to 255 levels and write 8 bit palette pictures", { "palette" });
+    args::ValueFlag<unsigned> benchRender(parser, "iterations", "Time whole renders and count their cache misses, then exit", { "bench-render" });
+    args::ValueFlag<unsigned> benchTransform(parser, "iterations", "Time the vertex transform stage alone and exit", { "bench-transform" });
+    args::Flag batch(parser, "batch", "Thumbnail every .stl file of the directory in (the files listed on stdin with in \"-\") into the directory out, in a pipeline", { "batch" });
+    args::Flag serve(parser, "serve", "Run as a server that renders the requests of stl2thumbnail-client", { "serve" });
+    args::ValueFlag<std::string> socketPath(parser, "path", "The socket of the server", { "socket" });
+    args::ValueFlag<unsigned> workers(parser, "count", "Requests the server renders at a time, 0 uses one per core", { "workers" }, 0);
+    args::ValueFlag<unsigned> queueSize(parser, "count", "Requests the server keeps waiting before it turns new ones away", { "queue" }, 64);
+    args::ValueFlag<unsigned> deadline(parser, "ms", "Milliseconds the server spends at most on a request that brings no deadline", { "deadline" }, 30000);
 
     try
     {
@@ -61,43 +257,137 @@ int main(int argc, char** argv)
         return 0;
     }
 
+    RenderJob job;
+    job.threads     = threads.Get();
+    job.frontToBack = frontToBack;
+    job.decimate    = decimateMesh;
+    job.keepOrder   = keepOrder;
+    job.png.palette = palette;
+    if (pngLevel)
+    {
+        job.png.level = std::max(0, std::min(pngLevel.Get(), 9));
+    }
+
+    if (pngFilterName && (job.png.filter = pngFilter(pngFilterName.Get())) < 0)
+    {
+        std::cerr << "Unknown PNG filter " << pngFilterName.Get() << std::endl;
+        return 1;
+    }
+
+    if (pngStrategyName && (job.png.strategy = pngStrategy(pngStrategyName.Get())) < 0)
+    {
+        std::cerr << "Unknown zlib strategy " << pngStrategyName.Get() << std::endl;
+        return 1;
+    }
+
+    if (serve)
+    {
+        ServerOptions options;
+        options.socketPath = socketPath ? socketPath.Get() : defaultSocketPath();
+        options.workers    = workers.Get();
+        options.queueSize  = queueSize.Get();
+        options.deadline   = deadline.Get();
+        options.job        = job;
+
+        if (runServer(options) != 0)
+        {
+            std::cerr << "Cannot listen on " << options.socketPath << std::endl;
+            return 1;
+        }
+        return 0;
+    }
+
+    if (!in)
+    {
+        std::cout << parser;
+        return 0;
+    }
+
     std::string size = picSize.Get();
     std::cout << size << std::endl;
 
-    unsigned width, height;
-    std::sscanf(size.c_str(), "%ux%u", &width, &height);
+    if (!parsePictureSize(size, job.width, job.height))
+    {
+        std::cerr << "Bad thumbnail size " << size << std::endl;
+        return 1;
+    }
+
+    job.views = std::max(1u, std::min(viewCount.Get(), unsigned(VIEW_POS.size())));
+
+    if (batch)
+    {
+        BatchOptions options;
+        options.input     = in.Get();
+        options.outputDir = out.Get();
+        options.threads   = threads.Get();
+        options.job       = job;
+
+        if (formatName && !imageFormat(std::string(".") + formatName.Get(), options.job.format))
+        {
+            std::cerr << "Unknown picture format " << formatName.Get() << std::endl;
+            return 1;
+        }
+
+        const int failed = runBatch(options);
+        if (failed < 0)
+        {
+            std::cerr << "Cannot read " << options.input << " or create " << options.outputDir << std::endl;
+        }
+        return failed != 0 ? 1 : 0;
+    }
+
+    ImageFormat format = IMAGE_PNG;
+    if (formatName && !imageFormat(std::string(".") + formatName.Get(), format))
+    {
+        std::cerr << "Unknown picture format " << formatName.Get() << std::endl;
+        return 1;
+    }
+
+    job.in = in.Get();
+    if (formatName)
+    {
+        setOutput(job, out.Get(), format);
+    }
+    else
+    {
+        setOutput(job, out.Get());
+    }
 
     // parse STL
     stl::Parser stlParser;
-    Mesh mesh;
-    try
+    stlParser.setPopulate(populate);
+    stlParser.setThreadCount(threads.Get());
+
+    if (stream)
     {
-        stlParser.parseFile(mesh, in.Get());
+        return renderStreaming(stlParser, job);
     }
-    catch (...)
+
+    IndexedMesh mesh;
+    stl::MeshStats stats;
+    if (loadMesh(stlParser, job, mesh, stats, &std::cout) != 0)
     {
-        std::cerr << "Cannot parse file " << in.Get();
+        std::cerr << "Cannot parse file " << job.in << std::endl;
         return 1;
     }
 
-    std::cout << "Triangles: " << mesh.size() << std::endl;
-
-    const int PIC_COUNT = 4;
-    const Vec3 view_pos[PIC_COUNT] = {{ -1.f, -1.f, 1.f }, { 1.f, -1.f, 1.f }, { 1.f, 1.f, -1.f }, { -1.f, 1.f, -1.f }};
+    if (benchRender && benchRender.Get() > 0)
+    {
+        return benchmarkRender(mesh, statsBounds(stats), stats.closed, job.width, job.height, benchRender.Get(), threads.Get());
+    }
 
-    for (int i = 0; i < PIC_COUNT; ++i)
+    if (benchTransform && benchTransform.Get() > 0)
     {
-        // render using raster backend
-        RasterBackend backend(width, height);
-        Picture pic(width, height);
-        backend.render(pic, mesh, view_pos[i]);
+        return benchmarkTransform(mesh, statsBounds(stats), job.width, job.height, benchTransform.Get(), threads.Get());
+    }
 
-        // save to disk
-        std::string png_file_path(out.Get());
-        png_file_path += "-";
-        png_file_path.append(std::to_string(i + 1));
-        png_file_path += ".png";
-        pic.save(png_file_path);
+    RenderContext context;
+    renderViews(context, job, mesh, stats, &std::cout);
+
+    if (savePictures(context, job) != 0)
+    {
+        std::cerr << "Cannot write " << job.out << std::endl;
+        return 1;
     }
 
     return 0;
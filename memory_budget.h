@@ -0,0 +1,67 @@
+/*
+Copyright (C) 2017  Paul Kremer
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+
+// bytes shared by threads: take() waits until the bytes fit besides what the others took,
+// give() hands them back. Something larger than the whole budget gets through once
+// nothing else is taken, so it waits but never forever
+class MemoryBudget
+{
+public:
+    explicit MemoryBudget(size_t bytes) : m_bytes(bytes)
+    {
+    }
+
+    MemoryBudget(const MemoryBudget&) = delete;
+    MemoryBudget& operator=(const MemoryBudget&) = delete;
+
+    void take(size_t bytes)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_available.wait(lock, [&] { return 0 == m_taken || m_taken + bytes <= m_bytes; });
+        m_taken += bytes;
+    }
+
+    // replaces taken bytes by bytes without waiting, for an estimate that turned out wrong
+    void settle(size_t taken, size_t bytes)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_taken = m_taken - taken + bytes;
+        if (bytes < taken)
+        {
+            m_available.notify_all();
+        }
+    }
+
+    void give(size_t bytes)
+    {
+        settle(bytes, 0);
+    }
+
+private:
+    std::mutex m_mutex;
+    std::condition_variable m_available;
+
+    size_t m_bytes;
+    size_t m_taken = 0;
+};
@@ -0,0 +1,146 @@
+/*
+Copyright (C) 2017  Paul Kremer
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "morton_order.h"
+#include <algorithm>
+
+// bits per axis of the curve, 1024 steps across the bounding box
+static const int MORTON_BITS = 10;
+
+// bits of the code sorted per radix pass, two passes
+static const int RADIX_BITS = 15;
+
+// a mesh is left as it is when more than 1 / COHERENT_SHARE of its consecutive triangles
+// fall into the same cell of a 16 x 16 x 16 grid. Scanner output in scan order does, a
+// shuffled file almost never
+static const int COHERENT_BITS    = 4;
+static const size_t COHERENT_SHARE = 8;
+
+// spreads the low 10 bits of v to every third bit
+static uint32_t spreadBits(uint32_t v)
+{
+    v = (v | (v << 16)) & 0x030000ff;
+    v = (v | (v << 8)) & 0x0300f00f;
+    v = (v | (v << 4)) & 0x030c30c3;
+    v = (v | (v << 2)) & 0x09249249;
+    return v;
+}
+
+static uint32_t cell(float v, float lower, float size)
+{
+    const float steps = float((1 << MORTON_BITS) - 1);
+    const float t     = size > 0.0f ? (v - lower) / size * steps : 0.0f;
+    return t > 0.0f ? uint32_t(std::min(t, steps)) : 0u; // NaN lands at 0
+}
+
+bool mortonOrder(IndexedMesh& mesh, const AABBox& aabb)
+{
+    const size_t count = mesh.size();
+    const Vec3 size    = aabb.size();
+
+    // code << 32 | triangle, sorted by the code only so equal codes keep the mesh order
+    std::vector<uint64_t> keys(count);
+    for (size_t i = 0; i < count; ++i)
+    {
+        const Vec3& a = mesh.vertices[mesh.indices[3 * i]];
+        const Vec3& b = mesh.vertices[mesh.indices[3 * i + 1]];
+        const Vec3& c = mesh.vertices[mesh.indices[3 * i + 2]];
+
+        const uint32_t x = cell((a.x + b.x + c.x) / 3.0f, aabb.lower.x, size.x);
+        const uint32_t y = cell((a.y + b.y + c.y) / 3.0f, aabb.lower.y, size.y);
+        const uint32_t z = cell((a.z + b.z + c.z) / 3.0f, aabb.lower.z, size.z);
+
+        keys[i] = uint64_t(spreadBits(x) | spreadBits(y) << 1 | spreadBits(z) << 2) << 32 | i;
+    }
+
+    size_t coherent = 0;
+    for (size_t i = 1; i < count; ++i)
+    {
+        if (0 == (keys[i] ^ keys[i - 1]) >> (32 + 3 * (MORTON_BITS - COHERENT_BITS)))
+        {
+            ++coherent;
+        }
+    }
+
+    if (coherent * COHERENT_SHARE > count)
+    {
+        return false;
+    }
+
+    // LSD radix sort on the code
+    const size_t digits = size_t(1) << RADIX_BITS;
+
+    std::vector<uint64_t> sorted(count);
+    std::vector<size_t> starts(digits + 1);
+
+    for (int shift = 32; shift < 32 + 3 * MORTON_BITS; shift += RADIX_BITS)
+    {
+        std::fill(starts.begin(), starts.end(), 0);
+        for (uint64_t key : keys)
+        {
+            starts[((key >> shift) & (digits - 1)) + 1] += 1;
+        }
+
+        for (size_t d = 1; d <= digits; ++d)
+        {
+            starts[d] += starts[d - 1];
+        }
+
+        for (uint64_t key : keys)
+        {
+            sorted[starts[(key >> shift) & (digits - 1)]++] = key;
+        }
+
+        keys.swap(sorted);
+    }
+
+    // the triangles in curve order, their vertices numbered by first use
+    const uint32_t UNUSED = ~uint32_t(0);
+
+    std::vector<uint32_t> vertexMap(mesh.vertices.size(), UNUSED);
+    std::vector<Vec3> vertices;
+    std::vector<uint32_t> indices(mesh.indices.size());
+    std::vector<Vec3> normals(count);
+
+    vertices.reserve(mesh.vertices.size());
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        const size_t t = size_t(keys[i] & 0xffffffff);
+
+        for (size_t k = 0; k < 3; ++k)
+        {
+            uint32_t& v = vertexMap[mesh.indices[3 * t + k]];
+            if (UNUSED == v)
+            {
+                v = uint32_t(vertices.size());
+                vertices.push_back(mesh.vertices[mesh.indices[3 * t + k]]);
+            }
+
+            indices[3 * i + k] = v;
+        }
+
+        normals[i] = mesh.normals[t];
+    }
+
+    mesh.vertices.swap(vertices);
+    mesh.indices.swap(indices);
+    mesh.normals.swap(normals);
+
+    return true;
+}
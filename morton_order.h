@@ -0,0 +1,31 @@
+/*
+Copyright (C) 2017  Paul Kremer
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#pragma once
+
+#include "aabb.h"
+#include "indexed_mesh.h"
+
+// meshes from this many triangles on are worth reordering before rendering
+static const size_t MORTON_ORDER_MIN_TRIANGLES = 1 << 16;
+
+// Sorts the triangles along a Morton (Z-order) curve through aabb, by their centroids, and
+// renumbers the vertices in the order the sorted triangles first use them. Triangles that
+// follow each other then touch neighbouring pixels and vertices, whatever order the file had.
+// A mesh that already is in such an order is left alone, the return value tells
+bool mortonOrder(IndexedMesh& mesh, const AABBox& aabb);
@@ -16,6 +16,13 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
 #include "picture.h"
+#include <sys/stat.h>
+#include <algorithm>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <tuple>
 //#include <iostream>
 
 static Byte floatToByte(float v)
@@ -41,7 +48,64 @@ Byte* Picture::data()
     return m_buffer.data();
 }
 
-int Picture::save(const std::string& file_path)
+size_t Picture::stride() const
+{
+    return m_stride;
+}
+
+int Picture::depth() const
+{
+    return m_depth;
+}
+
+static void fileWrite(png_structp png_ptr, png_bytep data, png_size_t length)
+{
+    FILE* fp = static_cast<FILE*>(png_get_io_ptr(png_ptr));
+    if (fwrite(data, 1, length, fp) != length)
+    {
+        png_error(png_ptr, "write error");
+    }
+}
+
+static void bufferWrite(png_structp png_ptr, png_bytep data, png_size_t length)
+{
+    Buffer* out = static_cast<Buffer*>(png_get_io_ptr(png_ptr));
+    out->insert(out->end(), data, data + length);
+}
+
+static void noFlush(png_structp)
+{
+}
+
+static const char* const IMAGE_EXTENSIONS[] = { ".png", ".qoi", ".rgba", ".ppm" };
+
+const char* imageExtension(ImageFormat format)
+{
+    return IMAGE_EXTENSIONS[format];
+}
+
+bool imageFormat(const std::string& file_path, ImageFormat& format)
+{
+    for (int f = IMAGE_PNG; f <= IMAGE_PPM; ++f)
+    {
+        const std::string ext(IMAGE_EXTENSIONS[f]);
+        if (file_path.size() >= ext.size() && 0 == file_path.compare(file_path.size() - ext.size(), ext.size(), ext))
+        {
+            format = ImageFormat(f);
+            return true;
+        }
+    }
+    return false;
+}
+
+int Picture::save(const std::string& file_path, const PngOptions& options) const
+{
+    ImageFormat format = IMAGE_PNG;
+    imageFormat(file_path, format);
+    return save(file_path, format, options);
+}
+
+int Picture::save(const std::string& file_path, ImageFormat format, const PngOptions& options) const
 {
     FILE* fp = fopen(file_path.c_str(), "wb");
     if (nullptr == fp)
@@ -49,10 +113,306 @@ int Picture::save(const std::string& file_path)
         return -1;
     }
 
-    png_structp png_ptr  = png_create_write_struct(PNG_LIBPNG_VER_STRING, nullptr, nullptr, nullptr);
+    int ret = 0;
+    if (IMAGE_PNG == format)
+    {
+        ret = encode(fileWrite, fp, options);
+    }
+    else
+    {
+        Buffer data;
+        encode(data, format, options);
+        ret = (fwrite(data.data(), 1, data.size(), fp) == data.size()) ? 0 : -1;
+    }
+
+    if (fclose(fp) != 0)
+    {
+        ret = -1;
+    }
+
+    return ret;
+}
+
+int Picture::encode(Buffer& out, const PngOptions& options) const
+{
+    return encode(out, IMAGE_PNG, options);
+}
+
+int Picture::encode(Buffer& out, ImageFormat format, const PngOptions& options) const
+{
+    out.clear();
+
+    switch (format)
+    {
+        case IMAGE_PNG:
+            return encode(bufferWrite, &out, options);
+
+        case IMAGE_QOI:
+            encodeQoi(out);
+            return 0;
+
+        case IMAGE_RGBA:
+        case IMAGE_PPM:
+            encodeRaw(out, format);
+            return 0;
+    }
+
+    return -1;
+}
+
+// https://qoiformat.org/qoi-specification.pdf
+void Picture::encodeQoi(Buffer& out) const
+{
+    const Byte QOI_OP_INDEX = 0x00;
+    const Byte QOI_OP_DIFF  = 0x40;
+    const Byte QOI_OP_LUMA  = 0x80;
+    const Byte QOI_OP_RUN   = 0xc0;
+    const Byte QOI_OP_RGB   = 0xfe;
+    const Byte QOI_OP_RGBA  = 0xff;
+
+    // header, the worst case of 1 + 4 bytes per pixel and the end marker
+    out.resize(14 + m_width * m_height * 5 + 8);
+    Byte* p = out.data();
+
+    const uint32_t header[] = { 0x716f6966u /* qoif */, uint32_t(m_width), uint32_t(m_height) };
+    for (uint32_t v : header)
+    {
+        *p++ = Byte(v >> 24);
+        *p++ = Byte(v >> 16);
+        *p++ = Byte(v >> 8);
+        *p++ = Byte(v);
+    }
+    *p++ = Byte(m_depth); // channels
+    *p++ = 0;             // sRGB with linear alpha
+
+    Byte index[64][4] = {};
+    Byte prev[4]      = { 0, 0, 0, 255 };
+    unsigned run      = 0;
+
+    const size_t count = m_width * m_height;
+    for (size_t y = 0, i = 0; y < m_height; ++y)
+    {
+        const Byte* row = &m_buffer[y * m_stride];
+
+        for (size_t x = 0; x < m_width; ++x, ++i)
+        {
+            const Byte* px = row + x * m_depth;
+            const Byte a   = (4 == m_depth) ? px[3] : 255;
+
+            if (px[0] == prev[0] && px[1] == prev[1] && px[2] == prev[2] && a == prev[3])
+            {
+                if (++run == 62 || i + 1 == count)
+                {
+                    *p++ = Byte(QOI_OP_RUN | (run - 1));
+                    run  = 0;
+                }
+                continue;
+            }
+
+            if (run > 0)
+            {
+                *p++ = Byte(QOI_OP_RUN | (run - 1));
+                run  = 0;
+            }
+
+            const unsigned hash = (px[0] * 3 + px[1] * 5 + px[2] * 7 + a * 11) % 64;
+            Byte* entry         = index[hash];
+
+            if (entry[0] == px[0] && entry[1] == px[1] && entry[2] == px[2] && entry[3] == a)
+            {
+                *p++ = Byte(QOI_OP_INDEX | hash);
+            }
+            else if (a == prev[3])
+            {
+                const int dr = int8_t(px[0] - prev[0]);
+                const int dg = int8_t(px[1] - prev[1]);
+                const int db = int8_t(px[2] - prev[2]);
+
+                const int drdg = dr - dg;
+                const int dbdg = db - dg;
+
+                if (dr >= -2 && dr <= 1 && dg >= -2 && dg <= 1 && db >= -2 && db <= 1)
+                {
+                    *p++ = Byte(QOI_OP_DIFF | (dr + 2) << 4 | (dg + 2) << 2 | (db + 2));
+                }
+                else if (dg >= -32 && dg <= 31 && drdg >= -8 && drdg <= 7 && dbdg >= -8 && dbdg <= 7)
+                {
+                    *p++ = Byte(QOI_OP_LUMA | (dg + 32));
+                    *p++ = Byte((drdg + 8) << 4 | (dbdg + 8));
+                }
+                else
+                {
+                    *p++ = QOI_OP_RGB;
+                    *p++ = px[0];
+                    *p++ = px[1];
+                    *p++ = px[2];
+                }
+            }
+            else
+            {
+                *p++ = QOI_OP_RGBA;
+                *p++ = px[0];
+                *p++ = px[1];
+                *p++ = px[2];
+                *p++ = a;
+            }
+
+            entry[0] = prev[0] = px[0];
+            entry[1] = prev[1] = px[1];
+            entry[2] = prev[2] = px[2];
+            entry[3] = prev[3] = a;
+        }
+    }
+
+    const Byte end[8] = { 0, 0, 0, 0, 0, 0, 0, 1 };
+    p = std::copy(end, end + 8, p);
+
+    out.resize(p - out.data());
+}
+
+void Picture::encodeRaw(Buffer& out, ImageFormat format) const
+{
+    const int depth = (IMAGE_PPM == format) ? 3 : 4;
+
+    std::string header;
+    if (IMAGE_PPM == format)
+    {
+        header = "P6\n" + std::to_string(m_width) + " " + std::to_string(m_height) + "\n255\n";
+    }
+
+    out.resize(header.size() + m_width * m_height * depth);
+    Byte* p = std::copy(header.begin(), header.end(), out.data());
+
+    for (size_t y = 0; y < m_height; ++y)
+    {
+        const Byte* row = &m_buffer[y * m_stride];
+
+        if (depth == m_depth)
+        {
+            p = std::copy(row, row + m_width * depth, p);
+            continue;
+        }
+
+        // RGB <-> RGBA, alpha is opaque or dropped
+        for (size_t x = 0; x < m_width; ++x, row += m_depth)
+        {
+            *p++ = row[0];
+            *p++ = row[1];
+            *p++ = row[2];
+            if (4 == depth)
+            {
+                *p++ = 255;
+            }
+        }
+    }
+}
+
+bool Picture::toPalette(Buffer& indices, std::vector<png_color>& colors, std::vector<png_byte>& alphas) const
+{
+    // packed RGBA -> palette index, open addressing
+    const size_t SLOTS = 1024;
+    uint32_t keys[SLOTS];
+    int16_t slotIndex[SLOTS];
+    std::fill(slotIndex, slotIndex + SLOTS, int16_t(-1));
+
+    std::vector<uint32_t> palette;
+    palette.reserve(256);
+    indices.resize(m_width * m_height);
+
+    uint32_t last    = 0;
+    Byte lastIndex   = 0;
+    bool lastIsValid = false;
+
+    for (size_t y = 0; y < m_height; ++y)
+    {
+        const Byte* p = &m_buffer[y * m_stride];
+        Byte* row     = &indices[y * m_width];
+
+        for (size_t x = 0; x < m_width; ++x, p += m_depth)
+        {
+            const uint32_t color = uint32_t(p[0]) | uint32_t(p[1]) << 8 | uint32_t(p[2]) << 16 | uint32_t(4 == m_depth ? p[3] : 255) << 24;
+
+            // the picture is mostly runs of background
+            if (!lastIsValid || color != last)
+            {
+                size_t slot = (color * 2654435761u) >> 22;
+                while (slotIndex[slot] >= 0 && keys[slot] != color)
+                {
+                    slot = (slot + 1) & (SLOTS - 1);
+                }
+
+                if (slotIndex[slot] < 0)
+                {
+                    if (palette.size() == 256)
+                    {
+                        return false;
+                    }
+
+                    keys[slot]      = color;
+                    slotIndex[slot] = int16_t(palette.size());
+                    palette.push_back(color);
+                }
+
+                last        = color;
+                lastIndex   = Byte(slotIndex[slot]);
+                lastIsValid = true;
+            }
+
+            row[x] = lastIndex;
+        }
+    }
+
+    // tRNS only needs the entries up to the last translucent one, so those go first
+    Byte remap[256];
+    size_t translucent = 0;
+    for (size_t i = 0; i < palette.size(); ++i)
+    {
+        translucent += (palette[i] >> 24) != 255;
+    }
+
+    if (translucent > 0)
+    {
+        std::vector<uint32_t> sorted;
+        size_t front = 0, back = translucent;
+        sorted.resize(palette.size());
+        for (size_t i = 0; i < palette.size(); ++i)
+        {
+            const size_t j = ((palette[i] >> 24) != 255) ? front++ : back++;
+            remap[i]       = Byte(j);
+            sorted[j]      = palette[i];
+        }
+        palette.swap(sorted);
+
+        for (Byte& index : indices)
+        {
+            index = remap[index];
+        }
+    }
+
+    colors.resize(palette.size());
+    alphas.resize(translucent);
+    for (size_t i = 0; i < palette.size(); ++i)
+    {
+        colors[i] = { png_byte(palette[i]), png_byte(palette[i] >> 8), png_byte(palette[i] >> 16) };
+        if (i < translucent)
+        {
+            alphas[i] = png_byte(palette[i] >> 24);
+        }
+    }
+
+    return true;
+}
+
+int Picture::encode(png_rw_ptr write_fn, void* io, const PngOptions& options) const
+{
+    Buffer indices;
+    std::vector<png_color> colors;
+    std::vector<png_byte> alphas;
+    const bool indexed = options.palette && toPalette(indices, colors, alphas);
+
+    png_structp png_ptr = png_create_write_struct(PNG_LIBPNG_VER_STRING, nullptr, nullptr, nullptr);
     if (nullptr == png_ptr)
     {
-        fclose(fp);
         return -1;
     }
 
@@ -60,26 +420,70 @@ int Picture::save(const std::string& file_path)
     if (nullptr == info_ptr)
     {
         png_destroy_write_struct(&png_ptr, nullptr);
-        fclose(fp);
         return -1;
     }
 
-    png_init_io(png_ptr, fp);
-    png_set_IHDR(png_ptr, info_ptr, m_width, m_height,
-                 8, (4 == m_depth) ? PNG_COLOR_TYPE_RGBA : PNG_COLOR_TYPE_RGB,
-                 PNG_INTERLACE_NONE, PNG_COMPRESSION_TYPE_BASE, PNG_FILTER_TYPE_BASE);
-    png_write_info(png_ptr, info_ptr);
+    if (setjmp(png_jmpbuf(png_ptr)))
+    {
+        png_destroy_write_struct(&png_ptr, &info_ptr);
+        return -1;
+    }
 
-    for (size_t y = 0; y < m_height; ++y)
+    png_set_write_fn(png_ptr, io, write_fn, noFlush);
+
+    // filtering indices predicts nothing, it only costs time and usually bytes
+    const int filter = options.filter >= 0 ? options.filter : (indexed ? PNG_FILTER_NONE : PNG_ALL_FILTERS);
+    png_set_filter(png_ptr, PNG_FILTER_TYPE_BASE, filter);
+    if (options.level >= 0)
     {
-        png_write_row(png_ptr, &m_buffer[y * m_stride]);
+        png_set_compression_level(png_ptr, options.level);
     }
 
-    png_write_end(png_ptr, nullptr);
+    if (options.strategy >= 0)
+    {
+        png_set_compression_strategy(png_ptr, options.strategy);
+    }
+
+    if (indexed)
+    {
+        // as few bits per pixel as the palette allows
+        int bitDepth = 8;
+        while (bitDepth > 1 && colors.size() <= (1u << (bitDepth / 2)))
+        {
+            bitDepth /= 2;
+        }
 
-    png_free_data(png_ptr, info_ptr, PNG_FREE_ALL, -1);
+        png_set_IHDR(png_ptr, info_ptr, m_width, m_height,
+                     bitDepth, PNG_COLOR_TYPE_PALETTE,
+                     PNG_INTERLACE_NONE, PNG_COMPRESSION_TYPE_BASE, PNG_FILTER_TYPE_BASE);
+        png_set_PLTE(png_ptr, info_ptr, colors.data(), int(colors.size()));
+        if (!alphas.empty())
+        {
+            png_set_tRNS(png_ptr, info_ptr, alphas.data(), int(alphas.size()), nullptr);
+        }
+        png_write_info(png_ptr, info_ptr);
+        png_set_packing(png_ptr);
+
+        for (size_t y = 0; y < m_height; ++y)
+        {
+            png_write_row(png_ptr, &indices[y * m_width]);
+        }
+    }
+    else
+    {
+        png_set_IHDR(png_ptr, info_ptr, m_width, m_height,
+                     8, (4 == m_depth) ? PNG_COLOR_TYPE_RGBA : PNG_COLOR_TYPE_RGB,
+                     PNG_INTERLACE_NONE, PNG_COMPRESSION_TYPE_BASE, PNG_FILTER_TYPE_BASE);
+        png_write_info(png_ptr, info_ptr);
+
+        for (size_t y = 0; y < m_height; ++y)
+        {
+            png_write_row(png_ptr, &m_buffer[y * m_stride]);
+        }
+    }
+
+    png_write_end(png_ptr, nullptr);
     png_destroy_write_struct(&png_ptr, &info_ptr);
-    fclose(fp);
 
     return 0;
 }
@@ -118,96 +522,152 @@ void Picture::setRGB(size_t x, size_t y, float r, float g, float b, float a)
     }
 }
 
-void Picture::setBackground()
+// reads the whole PNG fp into info_ptr, false if it is none or libpng gives up on it. Apart
+// from setjmp this frame holds nothing that a longjmp could leave behind
+static bool readPng(FILE* fp, png_structp png_ptr, png_infop info_ptr)
 {
-    FILE* fp = nullptr;
-    png_structp png_ptr = nullptr;
-    png_infop info_ptr = nullptr;
-    bool success = false;
+    if (setjmp(png_jmpbuf(png_ptr)))
+    {
+        return false;
+    }
+
+    /* 读取PNG_BYTES_TO_CHECK个字节的数据 */
+    const int PNG_BYTES_TO_CHECK = 4;
+    png_byte buf[PNG_BYTES_TO_CHECK];
+
+    if (fread(buf, 1, PNG_BYTES_TO_CHECK, fp) < PNG_BYTES_TO_CHECK)
+    {
+        return false;
+    }
+
+    /* 检测数据是否为PNG的签名 */
+    if (png_sig_cmp(buf, 0, PNG_BYTES_TO_CHECK) != 0)
+    {
+        return false;
+    }
+
+    png_init_io(png_ptr, fp);
+    png_set_sig_bytes(png_ptr, PNG_BYTES_TO_CHECK);
+    png_read_png(png_ptr, info_ptr, PNG_TRANSFORM_EXPAND, nullptr); /* 读取PNG图片信息和像素数据 */
+    return true;
+}
+
+// decodes the background png into width x height pixels of depth bytes, nullptr if it
+// cannot be read or has another size
+static std::shared_ptr<const Buffer> decodeBackground(const std::string& file_path, size_t width, size_t height, int depth)
+{
+    FILE* fp = fopen(file_path.c_str(), "rb");
+    if (nullptr == fp)
+    {
+        return nullptr;
+    }
+
+    png_structp png_ptr = png_create_read_struct(PNG_LIBPNG_VER_STRING, nullptr, nullptr, nullptr);
+    png_infop info_ptr  = (png_ptr != nullptr) ? png_create_info_struct(png_ptr) : nullptr;
+    std::shared_ptr<Buffer> pixels;
 
     do
     {
-        fp = fopen(m_bg_pic_file_path.c_str(), "rb");
-        if (nullptr == fp)
+        if (nullptr == info_ptr || !readPng(fp, png_ptr, info_ptr))
         {
             break;
         }
 
-        png_ptr = png_create_read_struct(PNG_LIBPNG_VER_STRING, nullptr, nullptr, nullptr);
-        if (nullptr == png_ptr)
+        const png_byte color_type = png_get_color_type(png_ptr, info_ptr);
+        if (png_get_image_width(png_ptr, info_ptr) != width || png_get_image_height(png_ptr, info_ptr) != height || png_get_bit_depth(png_ptr, info_ptr) != 8)
         {
             break;
         }
 
-        info_ptr = png_create_info_struct( png_ptr );
-        if (nullptr == info_ptr)
+        /* 其它色彩类型的图像就不读了 */
+        const int channels = (PNG_COLOR_TYPE_RGB_ALPHA == color_type) ? 4 : (PNG_COLOR_TYPE_RGB == color_type) ? 3 : 0;
+        if (0 == channels)
         {
             break;
         }
 
-        setjmp(png_jmpbuf(png_ptr));
-
-        /* 读取PNG_BYTES_TO_CHECK个字节的数据 */
-        const int PNG_BYTES_TO_CHECK = 4;
-        char buf[PNG_BYTES_TO_CHECK] = "";
+        /* row_pointers里边就是rgb(a)数据 */
+        png_bytep* row_pointers = png_get_rows(png_ptr, info_ptr);
+        pixels                  = std::make_shared<Buffer>(width * height * depth);
+        Byte* p                 = pixels->data();
 
-        int ret = fread(buf, 1, PNG_BYTES_TO_CHECK, fp);
-        if (ret < PNG_BYTES_TO_CHECK) /* 若读到的数据并没有PNG_BYTES_TO_CHECK个字节 */
+        for (size_t y = 0; y < height; ++y)
         {
-            break;
-        }
+            const png_bytep row = row_pointers[y];
 
-        /* 检测数据是否为PNG的签名 */
-        ret = png_sig_cmp((png_bytep) buf, (png_size_t) 0, PNG_BYTES_TO_CHECK);
-        if (ret != 0) /* 如果不是PNG的签名，则说明该文件不是PNG文件 */
-        {
-            break;
+            if (channels == depth)
+            {
+                p = std::copy(row, row + width * depth, p);
+                continue;
+            }
+
+            for (size_t x = 0; x < width; ++x, p += depth)
+            {
+                p[0] = row[x * channels + 0]; // red
+                p[1] = row[x * channels + 1]; // green
+                p[2] = row[x * channels + 2]; // blue
+
+                if (4 == depth)
+                {
+                    p[3] = 255; // alpha
+                }
+            }
         }
+    } while (0);
 
-        rewind(fp); /* 复位文件指针 */
+    png_destroy_read_struct(&png_ptr, (info_ptr != nullptr) ? &info_ptr : nullptr, nullptr);
+    fclose(fp);
 
-        png_init_io(png_ptr, fp);
-        png_read_png(png_ptr, info_ptr, PNG_TRANSFORM_EXPAND, nullptr); /* 读取PNG图片信息和像素数据 */
+    return pixels;
+}
 
-        const png_byte color_type = png_get_color_type(png_ptr, info_ptr);
-        const png_uint_32 w = png_get_image_width(png_ptr, info_ptr);
-        const png_uint_32 h = png_get_image_height(png_ptr, info_ptr);
-        if (w != m_width || h != m_height)
-        {
-            break;
-        }
+// every picture of a run has the same background: it is decoded once per path, size and
+// modification time and shared from then on
+static std::shared_ptr<const Buffer> cachedBackground(const std::string& file_path, size_t width, size_t height, int depth)
+{
+    struct Entry
+    {
+        bool loaded;
+        time_t mtime;
+        off_t size;
+        std::shared_ptr<const Buffer> pixels; // nullptr if it did not decode
+    };
 
-        /* 获取图像的所有行像素数据，row_pointers里边就是rgba数据 */
-        png_bytep* row_pointers = png_get_rows(png_ptr, info_ptr);
-        if (nullptr == row_pointers)
-        {
-            break;
-        }
+    static std::mutex mutex;
+    static std::map<std::tuple<std::string, size_t, size_t, int>, Entry> cache;
 
-        setBg(color_type, row_pointers, m_backgroundColor);
-        success = true;
-    } while (0);
+    struct stat st;
+    if (stat(file_path.c_str(), &st) != 0)
+    {
+        return nullptr;
+    }
 
-    if (!success)
+    std::lock_guard<std::mutex> lock(mutex);
+
+    Entry& entry = cache[std::make_tuple(file_path, width, height, depth)];
+    if (!entry.loaded || entry.mtime != st.st_mtime || entry.size != st.st_size)
     {
-        fill(m_backgroundColor.x, m_backgroundColor.y, m_backgroundColor.z, m_backgroundColor.w); // 设置背景色
+        entry = { true, st.st_mtime, st.st_size, decodeBackground(file_path, width, height, depth) };
     }
 
-    if (png_ptr != nullptr)
+    return entry.pixels;
+}
+
+void Picture::setBackground()
+{
+    std::shared_ptr<const Buffer> background;
+    if (!m_bg_pic_file_path.empty())
     {
-        if (info_ptr != nullptr)
-        {
-            png_destroy_read_struct(&png_ptr, &info_ptr, nullptr);
-        }
-        else
-        {
-            png_destroy_read_struct(&png_ptr, nullptr, nullptr);
-        }
+        background = cachedBackground(m_bg_pic_file_path, m_width, m_height, m_depth);
     }
 
-    if (fp != nullptr)
+    if (background)
     {
-        fclose(fp);
+        std::memcpy(m_buffer.data(), background->data(), m_buffer.size());
+    }
+    else
+    {
+        fill(m_backgroundColor.x, m_backgroundColor.y, m_backgroundColor.z, m_backgroundColor.w); // 设置背景色
     }
 }
 
@@ -218,91 +678,32 @@ void Picture::setBackground()
 
 void Picture::fill(float r, float g, float b, float a)
 {
-    for (size_t y = 0; y < m_height; ++y)
+    if (m_buffer.empty())
     {
-        for (size_t x = 0; x < m_width; ++x)
-        {
-            setRGB(x, y, r, g, b, a);
-        }
+        return;
     }
-}
 
-void Picture::setBg(png_byte color_type, png_bytep* row_pointers, const Vec4& bg_color)
-{
-    /* 根据不同的色彩类型进行相应处理 */
-    switch (color_type)
+    // the first row pixel by pixel, the others are copies of it
+    const Byte pixel[4] = { floatToByte(r), floatToByte(g), floatToByte(b), floatToByte(a) };
+    if (4 == m_depth)
     {
-        case PNG_COLOR_TYPE_RGB_ALPHA:
+        uint32_t packed;
+        std::memcpy(&packed, pixel, 4);
+        for (size_t x = 0; x < m_width; ++x)
         {
-            png_uint_32 pos = 0;
-
-            for (png_uint_32 y = 0; y < m_height; ++y)
-            {
-                for (png_uint_32 x = 0; x < m_width * 4; )
-                {
-                    /* 以下是RGBA数据，需要自己补充代码，保存RGBA数据 */
-                    m_buffer[pos++] = row_pointers[y][x++]; // red
-                    m_buffer[pos++] = row_pointers[y][x++]; // green
-                    m_buffer[pos++] = row_pointers[y][x++]; // blue
-
-                    if (4 == m_depth)
-                    {
-                        m_buffer[pos++] = row_pointers[y][x++]; // alpha
-                    }
-                }
-            }
-
-//            for ( y = 0; y < h; ++y )
-//            {
-//                for ( x = 0; x < w * 4; )
-//                {
-//                    /* 以下是RGBA数据，需要自己补充代码，保存RGBA数据 */
-//                    /* 目标内存 */ = row_pointers[y][x++]; // red
-//                    /* 目标内存 */ = row_pointers[y][x++]; // green
-//                    /* 目标内存 */ = row_pointers[y][x++]; // blue
-//                    /* 目标内存 */ = row_pointers[y][x++]; // alpha
-//                }
-//            }
+            std::memcpy(&m_buffer[x * 4], &packed, 4);
         }
-        break;
-
-        case PNG_COLOR_TYPE_RGB:
+    }
+    else
+    {
+        for (size_t x = 0; x < m_width; ++x)
         {
-            png_uint_32 pos = 0;
-
-            for (png_uint_32 y = 0; y < m_height; ++y)
-            {
-                for (png_uint_32 x = 0; x < m_width * 3; )
-                {
-                    /* 以下是RGBA数据，需要自己补充代码，保存RGBA数据 */
-                    m_buffer[pos++] = row_pointers[y][x++]; // red
-                    m_buffer[pos++] = row_pointers[y][x++]; // green
-                    m_buffer[pos++] = row_pointers[y][x++]; // blue
-
-                    if (4 == m_depth)
-                    {
-                        m_buffer[pos++] = 255; // alpha
-                    }
-                }
-            }
-//            for ( y = 0; y < h; ++y )
-//            {
-//                for ( x = 0; x < w * 3; )
-//                {
-//                    /* 目标内存 */ = row_pointers[y][x++]; // red
-//                    /* 目标内存 */ = row_pointers[y][x++]; // green
-//                    /* 目标内存 */ = row_pointers[y][x++]; // blue
-//                }
-//            }
+            std::memcpy(&m_buffer[x * m_depth], pixel, m_depth);
         }
-        break;
-
-        /* 其它色彩类型的图像就不读了 */
+    }
 
-        default:
-        {
-            fill(bg_color.x, bg_color.y, bg_color.z, bg_color.w); // 设置背景色
-        }
-        break;
+    for (size_t y = 1; y < m_height; ++y)
+    {
+        std::memcpy(&m_buffer[y * m_stride], m_buffer.data(), m_stride);
     }
 }
@@ -25,21 +25,58 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 using Byte   = unsigned char;
 using Buffer = std::vector<Byte>;
 
+// PNG encoder settings, the defaults are the ones of libpng. Thumbnails are mostly flat
+// background, a low level with a fixed filter is much faster and hardly any bigger
+struct PngOptions
+{
+    int level    = -1;              // zlib level 0..9, -1: libpng default (6)
+    int filter   = -1;              // PNG_FILTER_NONE, _SUB, _UP, _AVG, _PAETH or PNG_ALL_FILTERS (adaptive), -1: none for palette pictures, adaptive otherwise
+    int strategy = -1;              // Z_DEFAULT_STRATEGY, Z_FILTERED, Z_HUFFMAN_ONLY, Z_RLE, -1: libpng default
+    bool palette = false;           // 8 bit (or less) indexed color if the picture has at most 256 colors, see RasterBackend::setShadingLevels
+};
+
+// file formats Picture can write. QOI is lossless like PNG but a single pass without
+// zlib, RGBA is the bare pixels (4 bytes each, rows top down), PPM is binary RGB (P6)
+enum ImageFormat
+{
+    IMAGE_PNG,
+    IMAGE_QOI,
+    IMAGE_RGBA,
+    IMAGE_PPM,
+};
+
+// ".png", ".qoi", ".rgba" or ".ppm"
+const char* imageExtension(ImageFormat format);
+
+// the format the extension of file_path stands for, false if it is none of the above
+bool imageFormat(const std::string& file_path, ImageFormat& format);
+
 class Picture
 {
 public:
     explicit Picture(size_t width, size_t height, const char* bg_pic_file_path = nullptr, int depth = 4); // depth=3: rgb depth=4: rgba
 
     Byte* data();
-    int save(const std::string& file_path);
+    size_t stride() const;
+    int depth() const;
+    // the format follows the extension of file_path, PNG if it is an unknown one
+    int save(const std::string& file_path, const PngOptions& options = PngOptions()) const;
+    int save(const std::string& file_path, ImageFormat format, const PngOptions& options = PngOptions()) const;
+    // encodes into out, replacing its content but keeping its capacity
+    int encode(Buffer& out, const PngOptions& options = PngOptions()) const;
+    int encode(Buffer& out, ImageFormat format, const PngOptions& options = PngOptions()) const;
     void setRGB(size_t x, size_t y, Byte r, Byte g, Byte b, Byte a = 255);
     void setRGB(size_t x, size_t y, float r, float g, float b, float a = 1.0f);
     void setBackground();
 //    size_t size() const;
 
 private:
+    int encode(png_rw_ptr write_fn, void* io, const PngOptions& options) const;
+    void encodeQoi(Buffer& out) const;
+    void encodeRaw(Buffer& out, ImageFormat format) const;
+    // exact palette of the picture, false if it has more than 256 colors
+    bool toPalette(Buffer& indices, std::vector<png_color>& colors, std::vector<png_byte>& alphas) const;
     void fill(float r, float g, float b, float a);
-    void setBg(png_byte color_type, png_bytep* row_pointers, const Vec4& bg_color);
 
 private:
     size_t m_width = 0;
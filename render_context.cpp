@@ -0,0 +1,46 @@
+/*
+Copyright (C) 2017  Paul Kremer
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "render_context.h"
+
+void RenderContext::prepare(size_t width, size_t height, size_t views)
+{
+    if (!m_backend || width != m_width || height != m_height)
+    {
+        m_width  = width;
+        m_height = height;
+        m_backend.reset(new RasterBackend(width, height));
+        m_pictures.clear();
+    }
+
+    if (m_pictures.size() != views)
+    {
+        m_pictures.assign(views, Picture(width, height));
+        m_pictureList.clear();
+        for (auto& pic : m_pictures)
+        {
+            m_pictureList.push_back(&pic);
+        }
+    }
+}
+
+size_t RenderContext::footprint(size_t width, size_t height, size_t views)
+{
+    // RGBA pictures
+    return views * width * height * 4 + RasterBackend::footprint(width, height, views);
+}
@@ -0,0 +1,67 @@
+/*
+Copyright (C) 2017  Paul Kremer
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#pragma once
+
+#include <memory>
+#include <vector>
+#include "backends/raster/backend.h"
+#include "picture.h"
+
+// the render targets of one thumbnail size: a raster backend with its z-buffers and one
+// picture per view. Kept across views and files, so that after the first render of a size
+// a render neither allocates nor does anything but clear the targets
+class RenderContext
+{
+public:
+    RenderContext() = default;
+
+    RenderContext(const RenderContext&) = delete;
+    RenderContext& operator=(const RenderContext&) = delete;
+
+    // width x height targets for views pictures, only reallocated when one of them changes.
+    // A new size gets a new backend, so set the backend up after this
+    void prepare(size_t width, size_t height, size_t views);
+
+    // bytes prepare() and a render allocate for that: the pictures and what the backend keeps
+    // per view, without the buffers that grow with the mesh (RasterBackend::meshFootprint)
+    static size_t footprint(size_t width, size_t height, size_t views);
+
+    RasterBackend& backend()
+    {
+        return *m_backend;
+    }
+
+    Picture& picture(size_t view)
+    {
+        return m_pictures[view];
+    }
+
+    const std::vector<Picture*>& pictures() const
+    {
+        return m_pictureList;
+    }
+
+private:
+    size_t m_width = 0;
+    size_t m_height = 0;
+
+    std::unique_ptr<RasterBackend> m_backend;
+    std::vector<Picture> m_pictures;
+    std::vector<Picture*> m_pictureList;
+};
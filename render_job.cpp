@@ -0,0 +1,216 @@
+/*
+Copyright (C) 2017  Paul Kremer
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "render_job.h"
+#include <algorithm>
+#include <iostream>
+#include <topology.h>
+
+#include "decimate.h"
+#include "morton_order.h"
+
+const std::vector<Vec3> VIEW_POS = {{ -1.f, -1.f, 1.f }, { 1.f, -1.f, 1.f }, { 1.f, 1.f, -1.f }, { -1.f, 1.f, -1.f }};
+
+AABBox statsBounds(const stl::MeshStats& stats)
+{
+    AABBox aabb;
+    aabb.lower = stats.lower;
+    aabb.upper = stats.upper;
+    return aabb;
+}
+
+void printStats(std::ostream& log, const stl::MeshStats& stats)
+{
+    log << "Triangles: " << stats.triangles;
+    if (stats.degenerate > 0)
+    {
+        log << " Degenerate: " << stats.degenerate;
+    }
+
+    if (stats.nanNormals > 0)
+    {
+        log << " NaN normals: " << stats.nanNormals;
+    }
+
+    log << std::endl;
+}
+
+void printCounters(std::ostream& log, const RasterCounters& counters)
+{
+    log << "Fragments: " << counters.fragments << " Rejected: " << counters.rejected;
+    if (counters.fragments > 0)
+    {
+        log << " (" << 100 * counters.rejected / counters.fragments << "%)";
+    }
+
+    log << " Culled: " << counters.culledTriangles << " triangles, " << counters.culledBlocks << " blocks" << std::endl;
+}
+
+void setOutput(RenderJob& job, const std::string& out)
+{
+    job.out    = out;
+    job.format = IMAGE_PNG;
+
+    if (imageFormat(job.out, job.format) && job.views > 1)
+    {
+        job.out.resize(job.out.size() - std::string(imageExtension(job.format)).size());
+    }
+}
+
+void setOutput(RenderJob& job, const std::string& out, ImageFormat format)
+{
+    setOutput(job, out);
+
+    if (1 == job.views && job.format != format)
+    {
+        ImageFormat named = IMAGE_PNG;
+        if (imageFormat(job.out, named))
+        {
+            job.out.resize(job.out.size() - std::string(imageExtension(named)).size());
+        }
+        job.out += imageExtension(format);
+    }
+
+    job.format = format;
+}
+
+std::string picturePath(const RenderJob& job, size_t index)
+{
+    if (1 == job.views)
+    {
+        return job.out;
+    }
+
+    std::string png_file_path(job.out);
+    png_file_path += "-";
+    png_file_path.append(std::to_string(index + 1));
+    png_file_path += imageExtension(job.format);
+    return png_file_path;
+}
+
+int loadMesh(const stl::Parser& parser, const RenderJob& job, IndexedMesh& mesh, stl::MeshStats& stats, std::ostream* log)
+{
+    try
+    {
+        if (parser.parseFile(mesh, job.in, &stats, job.cancel) != 0)
+        {
+            return -1;
+        }
+    }
+    catch (...)
+    {
+        return -1;
+    }
+
+    if (log)
+    {
+        printStats(*log, stats);
+        *log << "Vertices: " << mesh.vertices.size() << (stats.closed ? " closed" : " open") << std::endl;
+    }
+
+    if (job.decimate)
+    {
+        IndexedMesh simplified;
+        decimate(mesh, statsBounds(stats), decimationCellSize(statsBounds(stats), job.width, job.height), simplified);
+        std::swap(mesh, simplified);
+
+        // collapsing vertices can pinch the surface
+        stats.closed = stl::isClosed(mesh);
+
+        if (log)
+        {
+            *log << "Decimated: " << mesh.size() << " triangles, " << mesh.vertices.size() << " vertices" << (stats.closed ? " closed" : " open") << std::endl;
+        }
+    }
+
+    if (!job.keepOrder && mesh.size() >= MORTON_ORDER_MIN_TRIANGLES)
+    {
+        if (mortonOrder(mesh, statsBounds(stats)) && log)
+        {
+            *log << "Reordered along a Morton curve" << std::endl;
+        }
+    }
+
+    return 0;
+}
+
+int renderViews(RenderContext& context, const RenderJob& job, const IndexedMesh& mesh, const stl::MeshStats& stats, std::ostream* log)
+{
+    // the first 1, 2, ... views, kept around so that rendering does not allocate
+    static const std::vector<std::vector<Vec3>> VIEW_SETS = [] {
+        std::vector<std::vector<Vec3>> sets;
+        for (size_t n = 1; n <= VIEW_POS.size(); ++n)
+        {
+            sets.emplace_back(VIEW_POS.begin(), VIEW_POS.begin() + n);
+        }
+        return sets;
+    }();
+
+    const size_t views = std::max<size_t>(1, std::min(job.views, VIEW_POS.size()));
+    context.prepare(job.width, job.height, views);
+
+    // render all views using raster backend
+    RasterBackend& backend = context.backend();
+    backend.setThreadCount(job.threads);
+    backend.setFrontToBack(job.frontToBack);
+    backend.setBackFaceCulling(stats.closed);
+    backend.setShadingLevels(job.png.palette ? PALETTE_SHADING_LEVELS : 0);
+    backend.setCancel(job.cancel);
+    const int ret = backend.render(context.pictures(), mesh, statsBounds(stats), VIEW_SETS[views - 1]);
+
+    if (log)
+    {
+        printCounters(*log, backend.counters());
+    }
+
+    return ret;
+}
+
+int savePictures(RenderContext& context, const RenderJob& job)
+{
+    int ret = 0;
+
+    // save to disk
+    for (size_t i = 0; i < context.pictures().size(); ++i)
+    {
+        if (context.picture(i).save(picturePath(job, i), job.format, job.png) != 0)
+        {
+            ret = -1;
+        }
+    }
+
+    return ret;
+}
+
+int runRenderJob(RenderContext& context, const stl::Parser& parser, const RenderJob& job, std::ostream* log)
+{
+    IndexedMesh mesh;
+    stl::MeshStats stats;
+
+    if (loadMesh(parser, job, mesh, stats, log) != 0)
+    {
+        return -1;
+    }
+
+    if (renderViews(context, job, mesh, stats, log) != 0)
+    {
+        return -1;
+    }
+
+    return savePictures(context, job);
+}
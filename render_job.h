@@ -0,0 +1,82 @@
+/*
+Copyright (C) 2017  Paul Kremer
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#pragma once
+
+#include <functional>
+#include <iosfwd>
+#include <string>
+#include <vector>
+#include <mesh_stats.h>
+#include <parser.h>
+
+#include "aabb.h"
+#include "backends/raster/kernel.h"
+#include "indexed_mesh.h"
+#include "picture.h"
+#include "render_context.h"
+
+// the directions the views look at the model from, a thumbnail uses the first one
+extern const std::vector<Vec3> VIEW_POS;
+
+// light levels of palette pictures: with the background 256 colors
+static const unsigned PALETTE_SHADING_LEVELS = 254;
+
+// one stl file to thumbnails
+struct RenderJob
+{
+    std::string in;
+    std::string out; // with several views the prefix of out-1.png, ... with one the picture itself, see setOutput()
+    unsigned width     = 0;
+    unsigned height    = 0;
+    size_t views       = VIEW_POS.size(); // the first views of VIEW_POS
+    ImageFormat format = IMAGE_PNG;
+    PngOptions png;
+    unsigned threads = 0; // of the backend, 0: one per hardware thread
+
+    bool frontToBack = false;
+    bool decimate    = false;
+    bool keepOrder   = false;
+
+    // asked while parsing and rendering, the step stops early with -1 once it returns true
+    std::function<bool()> cancel;
+};
+
+AABBox statsBounds(const stl::MeshStats& stats);
+void printStats(std::ostream& log, const stl::MeshStats& stats);
+void printCounters(std::ostream& log, const RasterCounters& counters);
+
+// job.out and job.format for out, after job.views: the format follows the extension (PNG
+// for others) and with several views out.qoi writes out-1.qoi, out-2.qoi, ...
+void setOutput(RenderJob& job, const std::string& out);
+// the same with the format given: a single picture gets its extension, in place of the
+// extension of another format out may have, so out.png holds a PNG only
+void setOutput(RenderJob& job, const std::string& out, ImageFormat format);
+
+// the file of view index: job.out itself for a single view, out-<index + 1>.<format> otherwise
+std::string picturePath(const RenderJob& job, size_t index);
+
+// the three steps of a job, log receives what a step found out and may be nullptr.
+// loadMesh parses job.in and prepares the mesh: decimation and Morton order. renderViews
+// returns -1 when job.cancel stopped it
+int loadMesh(const stl::Parser& parser, const RenderJob& job, IndexedMesh& mesh, stl::MeshStats& stats, std::ostream* log);
+int renderViews(RenderContext& context, const RenderJob& job, const IndexedMesh& mesh, const stl::MeshStats& stats, std::ostream* log);
+int savePictures(RenderContext& context, const RenderJob& job);
+
+// all three, -1 if the file cannot be parsed, the job is cancelled or a picture cannot be written
+int runRenderJob(RenderContext& context, const stl::Parser& parser, const RenderJob& job, std::ostream* log);
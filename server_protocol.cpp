@@ -0,0 +1,189 @@
+/*
+Copyright (C) 2017  Paul Kremer
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "server_protocol.h"
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+std::string defaultSocketPath()
+{
+    const char* runtime = getenv("XDG_RUNTIME_DIR");
+    if (runtime != nullptr && runtime[0] != '\0')
+    {
+        return std::string(runtime) + "/stl2thumbnail.sock";
+    }
+
+    return "/tmp/stl2thumbnail-" + std::to_string(getuid()) + ".sock";
+}
+
+bool parsePictureSize(const std::string& size, unsigned& width, unsigned& height)
+{
+    char rest = 0;
+    if (std::sscanf(size.c_str(), "%ux%u%c", &width, &height, &rest) == 2)
+    {
+        return width > 0 && height > 0;
+    }
+
+    if (std::sscanf(size.c_str(), "%u%c", &width, &rest) == 1)
+    {
+        height = width;
+        return width > 0;
+    }
+
+    return false;
+}
+
+bool formatRequest(const ThumbnailRequest& request, std::string& line)
+{
+    for (const std::string* path : { &request.in, &request.out })
+    {
+        if (path->empty() || path->find_first_of("\t\r\n") != std::string::npos)
+        {
+            return false;
+        }
+    }
+
+    line = request.in + '\t' + request.out + '\t' + std::to_string(request.width) + '\t' + std::to_string(request.height) + '\t' + std::to_string(request.views) + '\t' + std::to_string(request.deadline) + '\n';
+    return true;
+}
+
+bool parseRequest(const std::string& line, ThumbnailRequest& request)
+{
+    std::string fields[6];
+    size_t begin = 0;
+
+    for (int i = 0; i < 6; ++i)
+    {
+        const size_t end = (i < 5) ? line.find('\t', begin) : line.size();
+        if (std::string::npos == end)
+        {
+            return false;
+        }
+
+        fields[i] = line.substr(begin, end - begin);
+        begin     = end + 1;
+    }
+
+    unsigned numbers[4];
+    for (int i = 0; i < 4; ++i)
+    {
+        char* end                 = nullptr;
+        const char* field         = fields[2 + i].c_str();
+        const unsigned long value = std::strtoul(field, &end, 10);
+        if (end == field || *end != '\0' || value > 1000000)
+        {
+            return false;
+        }
+        numbers[i] = unsigned(value);
+    }
+
+    request.in       = fields[0];
+    request.out      = fields[1];
+    request.width    = numbers[0];
+    request.height   = numbers[1];
+    request.views    = numbers[2];
+    request.deadline = numbers[3];
+
+    return !request.in.empty() && !request.out.empty() && request.width > 0 && request.height > 0 && request.width <= MAX_PICTURE_SIZE && request.height <= MAX_PICTURE_SIZE;
+}
+
+int readLine(int fd, std::string& line, size_t max_size)
+{
+    line.clear();
+
+    char buffer[512];
+    for (;;)
+    {
+        const ssize_t n = recv(fd, buffer, sizeof(buffer), 0);
+        if (n < 0 && EINTR == errno)
+        {
+            continue;
+        }
+
+        if (n <= 0)
+        {
+            return -1;
+        }
+
+        const char* newline = static_cast<const char*>(memchr(buffer, '\n', size_t(n)));
+        line.append(buffer, newline != nullptr ? size_t(newline - buffer) : size_t(n));
+
+        if (line.size() > max_size)
+        {
+            return -1;
+        }
+
+        if (newline != nullptr)
+        {
+            return 0;
+        }
+    }
+}
+
+int writeAll(int fd, const std::string& data)
+{
+    size_t written = 0;
+    while (written < data.size())
+    {
+        // a client that went away must not kill the server with SIGPIPE
+        const ssize_t n = send(fd, data.data() + written, data.size() - written, MSG_NOSIGNAL);
+        if (n < 0 && EINTR == errno)
+        {
+            continue;
+        }
+
+        if (n <= 0)
+        {
+            return -1;
+        }
+
+        written += size_t(n);
+    }
+
+    return 0;
+}
+
+int connectSocket(const std::string& path)
+{
+    sockaddr_un address = {};
+    address.sun_family  = AF_UNIX;
+    if (path.size() >= sizeof(address.sun_path))
+    {
+        return -1;
+    }
+    std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+
+    const int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0)
+    {
+        return -1;
+    }
+
+    if (connect(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0)
+    {
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
@@ -0,0 +1,60 @@
+/*
+Copyright (C) 2017  Paul Kremer
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+// What the thumbnail server and its client say to each other over a Unix stream socket.
+// The client sends one request line: in, out, width, height, views and deadline separated
+// by tabs. The server answers with one line once the pictures are written or it gave up:
+// "OK", "ERROR <reason>", "TIMEOUT" (the deadline passed) or "BUSY" (the queue is full)
+
+// the largest width or height a request may ask for. Beyond it a picture and its z-buffers
+// take more memory than a thumbnail is worth
+static const unsigned MAX_PICTURE_SIZE = 8192;
+
+struct ThumbnailRequest
+{
+    std::string in;
+    std::string out;
+    unsigned width    = 0;
+    unsigned height   = 0;
+    unsigned views    = 1; // 1 writes out itself, see RenderJob
+    unsigned deadline = 0; // milliseconds from accepting the connection, 0: the server default
+};
+
+// $XDG_RUNTIME_DIR/stl2thumbnail.sock, /tmp/stl2thumbnail-<uid>.sock without it
+std::string defaultSocketPath();
+
+// "WxH" or "N" for N x N like the thumbnailer passes it
+bool parsePictureSize(const std::string& size, unsigned& width, unsigned& height);
+
+// false if a path cannot be sent: it holds a tab or a line break
+bool formatRequest(const ThumbnailRequest& request, std::string& line);
+// false for malformed lines and sizes above MAX_PICTURE_SIZE, the server answers ERROR
+bool parseRequest(const std::string& line, ThumbnailRequest& request);
+
+// reads up to the next '\n' (not stored), -1 on errors, timeouts, end of stream or a line
+// longer than max_size
+int readLine(int fd, std::string& line, size_t max_size);
+int writeAll(int fd, const std::string& data);
+
+// a connected stream socket or -1
+int connectSocket(const std::string& path);
@@ -0,0 +1,32 @@
+# renders MODEL with and without --stream into OUT_DIR and fails unless every view is
+# byte for byte the same. cmake -DPROGRAM=... -DMODEL=... -DOUT_DIR=... -P compare_stream.cmake
+
+get_filename_component(name ${MODEL} NAME_WE)
+file(MAKE_DIRECTORY ${OUT_DIR})
+
+foreach (mode default stream)
+    if (mode STREQUAL "stream")
+        set(flags "--stream")
+    else ()
+        set(flags "")
+    endif ()
+
+    execute_process(
+        COMMAND ${PROGRAM} ${MODEL} ${OUT_DIR}/${name}-${mode} -s 256x192 ${flags}
+        RESULT_VARIABLE result
+        OUTPUT_QUIET
+    )
+    if (NOT result EQUAL 0)
+        message(FATAL_ERROR "${mode} render of ${MODEL} failed: ${result}")
+    endif ()
+endforeach ()
+
+foreach (view 1 2 3 4)
+    execute_process(
+        COMMAND ${CMAKE_COMMAND} -E compare_files ${OUT_DIR}/${name}-default-${view}.png ${OUT_DIR}/${name}-stream-${view}.png
+        RESULT_VARIABLE result
+    )
+    if (NOT result EQUAL 0)
+        message(FATAL_ERROR "view ${view} of ${MODEL} differs with --stream")
+    endif ()
+endforeach ()
@@ -0,0 +1,68 @@
+/*
+Copyright (C) 2017  Paul Kremer
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+// requests survive formatRequest and parseRequest, malformed or oversized ones are refused
+
+#include <iostream>
+#include "server_protocol.h"
+
+static int failures = 0;
+
+static void check(bool ok, const char* what)
+{
+    if (!ok)
+    {
+        std::cerr << "failed: " << what << std::endl;
+        failures += 1;
+    }
+}
+
+int main()
+{
+    ThumbnailRequest request;
+    request.in       = "/models/a b.stl";
+    request.out      = "/thumbnails/a b.png";
+    request.width    = 256;
+    request.height   = 128;
+    request.views    = 2;
+    request.deadline = 500;
+
+    std::string line;
+    check(formatRequest(request, line), "format");
+    check(line.back() == '\n', "line break");
+    line.pop_back();
+
+    ThumbnailRequest parsed;
+    check(parseRequest(line, parsed), "parse");
+    check(parsed.in == request.in && parsed.out == request.out, "paths");
+    check(parsed.width == 256 && parsed.height == 128 && parsed.views == 2 && parsed.deadline == 500, "numbers");
+
+    check(parseRequest("a.stl\ta.png\t8192\t8192\t1\t0", parsed), "largest size");
+    check(!parseRequest("a.stl\ta.png\t8193\t64\t1\t0", parsed), "too wide");
+    check(!parseRequest("a.stl\ta.png\t64\t8193\t1\t0", parsed), "too high");
+    check(!parseRequest("a.stl\ta.png\t1000000\t1000000\t1\t0", parsed), "huge");
+    check(!parseRequest("a.stl\ta.png\t-1\t64\t1\t0", parsed), "negative");
+    check(!parseRequest("a.stl\ta.png\t0\t64\t1\t0", parsed), "empty");
+    check(!parseRequest("a.stl\ta.png\t64\t64\t1", parsed), "missing field");
+    check(!parseRequest("a.stl\ta.png\t64x\t64\t1\t0", parsed), "not a number");
+
+    request.in = "tab\there.stl";
+    check(!formatRequest(request, line), "tab in a path");
+
+    return failures > 0 ? 1 : 0;
+}
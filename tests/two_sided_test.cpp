@@ -0,0 +1,139 @@
+/*
+Copyright (C) 2017  Paul Kremer
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+// a closed mesh drawn from both sides shows the same pixels as with back-face culling: the
+// back sides are all hidden behind front sides. Checked on the stl files given and on a
+// finely tessellated sphere, whose silhouette is one long fold of front and back sides
+
+#include <iostream>
+#include "render_job.h"
+
+// rings x segments quads between the poles, wound outwards
+static IndexedMesh sphere(size_t rings, size_t segments)
+{
+    const float pi = 3.14159265f;
+
+    IndexedMesh mesh;
+    mesh.vertices.push_back({ 0.0f, 0.0f, 1.0f });
+    for (size_t r = 1; r < rings; ++r)
+    {
+        const float theta = pi * r / rings;
+        for (size_t s = 0; s < segments; ++s)
+        {
+            const float phi = 2.0f * pi * s / segments;
+            mesh.vertices.push_back({ std::sin(theta) * std::cos(phi), std::sin(theta) * std::sin(phi), std::cos(theta) });
+        }
+    }
+    mesh.vertices.push_back({ 0.0f, 0.0f, -1.0f });
+
+    const uint32_t south = uint32_t(mesh.vertices.size() - 1);
+    auto ring = [&](size_t r, size_t s) {
+        return 0 == r ? 0u : r == rings ? south : uint32_t(1 + (r - 1) * segments + s % segments);
+    };
+
+    auto add = [&](uint32_t a, uint32_t b, uint32_t c) {
+        if (a == b || b == c || c == a)
+        {
+            return;
+        }
+
+        Vec3 n = cross(mesh.vertices[b] - mesh.vertices[a], mesh.vertices[c] - mesh.vertices[a]).normalize();
+        if (dot(n, mesh.vertices[a]) < 0.0f)
+        {
+            std::swap(b, c);
+            n = -n;
+        }
+
+        mesh.indices.insert(mesh.indices.end(), { a, b, c });
+        mesh.normals.push_back(n);
+    };
+
+    for (size_t r = 0; r < rings; ++r)
+    {
+        for (size_t s = 0; s < segments; ++s)
+        {
+            add(ring(r, s), ring(r + 1, s), ring(r + 1, s + 1));
+            add(ring(r, s), ring(r + 1, s + 1), ring(r, s + 1));
+        }
+    }
+
+    return mesh;
+}
+
+// bytes of the views that differ between the culled and the two-sided render
+static int compare(const std::string& name, const IndexedMesh& mesh)
+{
+    const size_t size = 256;
+    const AABBox aabb(mesh);
+
+    RenderContext culled, twoSided;
+    culled.prepare(size, size, VIEW_POS.size());
+    twoSided.prepare(size, size, VIEW_POS.size());
+
+    culled.backend().setBackFaceCulling(true);
+    culled.backend().render(culled.pictures(), mesh, aabb, VIEW_POS);
+    twoSided.backend().setBackFaceCulling(false);
+    twoSided.backend().render(twoSided.pictures(), mesh, aabb, VIEW_POS);
+
+    int ret = 0;
+    for (size_t v = 0; v < VIEW_POS.size(); ++v)
+    {
+        const Byte* a = culled.picture(v).data();
+        const Byte* b = twoSided.picture(v).data();
+
+        size_t differ = 0;
+        for (size_t k = 0; k < culled.picture(v).stride() * size; ++k)
+        {
+            differ += a[k] != b[k];
+        }
+
+        if (differ > 0)
+        {
+            std::cerr << name << " view " << v + 1 << ": " << differ << " bytes differ without culling" << std::endl;
+            ret = 1;
+        }
+    }
+
+    return ret;
+}
+
+int main(int argc, char** argv)
+{
+    int ret = compare("sphere", sphere(96, 192));
+
+    stl::Parser parser;
+    for (int i = 1; i < argc; ++i)
+    {
+        RenderJob job;
+        job.in        = argv[i];
+        job.keepOrder = true;
+
+        IndexedMesh mesh;
+        stl::MeshStats stats;
+        if (loadMesh(parser, job, mesh, stats, nullptr) != 0 || !stats.closed)
+        {
+            std::cerr << job.in << ": cannot be parsed or is not closed" << std::endl;
+            ret = 1;
+            continue;
+        }
+
+        ret |= compare(job.in, mesh);
+    }
+
+    return ret;
+}
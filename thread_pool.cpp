@@ -0,0 +1,120 @@
+/*
+Copyright (C) 2017  Paul Kremer
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "thread_pool.h"
+#include <algorithm>
+
+ThreadPool::ThreadPool(unsigned threads)
+{
+    if (0 == threads)
+    {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    for (unsigned i = 1; i < threads; ++i)
+    {
+        m_workers.emplace_back(&ThreadPool::workerLoop, this);
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+
+    m_wake.notify_all();
+
+    for (auto& t : m_workers)
+    {
+        t.join();
+    }
+}
+
+void ThreadPool::runTasks(size_t count, void (*task)(void*, size_t), void* context)
+{
+    if (m_workers.empty() || count <= 1)
+    {
+        for (size_t i = 0; i < count; ++i)
+        {
+            task(context, i);
+        }
+
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_task    = task;
+        m_context = context;
+        m_count   = count;
+        m_next    = 0;
+        m_active  = m_workers.size();
+        ++m_generation;
+    }
+
+    m_wake.notify_all();
+
+    workOn(task, context, count);
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_done.wait(lock, [this] { return 0 == m_active; });
+}
+
+void ThreadPool::workOn(void (*task)(void*, size_t), void* context, size_t count)
+{
+    for (size_t i = m_next++; i < count; i = m_next++)
+    {
+        task(context, i);
+    }
+}
+
+void ThreadPool::workerLoop()
+{
+    uint64_t seen = 0;
+
+    while (true)
+    {
+        void (*task)(void*, size_t) = nullptr;
+        void* context               = nullptr;
+        size_t count                = 0;
+
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_wake.wait(lock, [&] { return m_stop || m_generation != seen; });
+
+            if (m_stop)
+            {
+                return;
+            }
+
+            seen    = m_generation;
+            task    = m_task;
+            context = m_context;
+            count   = m_count;
+        }
+
+        workOn(task, context, count);
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (0 == --m_active)
+        {
+            m_done.notify_one();
+        }
+    }
+}
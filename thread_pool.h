@@ -0,0 +1,75 @@
+/*
+Copyright (C) 2017  Paul Kremer
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// a fixed set of worker threads that run indexed tasks, the calling thread helps out
+class ThreadPool
+{
+public:
+    explicit ThreadPool(unsigned threads = 0); // threads including the caller, 0: one per hardware thread
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    size_t size() const
+    {
+        return m_workers.size() + 1;
+    }
+
+    // calls fn(i) for i in [0, count) and returns once all calls are done
+    template <typename Fn>
+    void run(size_t count, Fn& fn)
+    {
+        runTasks(count, &invoke<Fn>, &fn);
+    }
+
+private:
+    template <typename Fn>
+    static void invoke(void* fn, size_t index)
+    {
+        (*static_cast<Fn*>(fn))(index);
+    }
+
+    void runTasks(size_t count, void (*task)(void*, size_t), void* context);
+    void workOn(void (*task)(void*, size_t), void* context, size_t count);
+    void workerLoop();
+
+private:
+    std::vector<std::thread> m_workers;
+    std::mutex m_mutex;
+    std::condition_variable m_wake;
+    std::condition_variable m_done;
+
+    // the job currently being run
+    void (*m_task)(void*, size_t) = nullptr;
+    void* m_context               = nullptr;
+    size_t m_count                = 0;
+    std::atomic<size_t> m_next{ 0 };
+    size_t m_active       = 0; // workers still working on the current job
+    uint64_t m_generation = 0;
+    bool m_stop           = false;
+};
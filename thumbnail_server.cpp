@@ -0,0 +1,236 @@
+/*
+Copyright (C) 2017  Paul Kremer
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "thumbnail_server.h"
+#include <poll.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include "bounded_queue.h"
+#include "server_protocol.h"
+
+using Clock = std::chrono::steady_clock;
+
+// longest request line and how long a client may take to send it
+static const size_t MAX_REQUEST_SIZE     = 8192;
+static const int REQUEST_TIMEOUT_SECONDS = 5;
+
+// how often the accept loop looks for a stop signal
+static const int STOP_POLL_MS = 500;
+
+static volatile sig_atomic_t s_stop = 0;
+
+static void requestStop(int)
+{
+    s_stop = 1;
+}
+
+struct Connection
+{
+    int fd = -1;
+    Clock::time_point accepted;
+};
+
+static int listenSocket(const std::string& path)
+{
+    sockaddr_un address = {};
+    address.sun_family  = AF_UNIX;
+    if (path.size() >= sizeof(address.sun_path))
+    {
+        return -1;
+    }
+    std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+
+    // a socket file nobody answers on is left over from a server that died
+    const int probe = connectSocket(path);
+    if (probe >= 0)
+    {
+        close(probe);
+        return -1;
+    }
+    unlink(path.c_str());
+
+    const int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0)
+    {
+        return -1;
+    }
+
+    // only the user may ask for thumbnails, they are written with the server's rights
+    const mode_t mask = umask(0077);
+    const bool bound  = 0 == bind(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address));
+    umask(mask);
+
+    if (!bound || listen(fd, SOMAXCONN) != 0)
+    {
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+static std::string serve(const Connection& connection, const ServerOptions& options, RenderContext& context, const stl::Parser& parser)
+{
+    timeval timeout = { REQUEST_TIMEOUT_SECONDS, 0 };
+    setsockopt(connection.fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+    std::string line;
+    ThumbnailRequest request;
+    if (readLine(connection.fd, line, MAX_REQUEST_SIZE) != 0 || !parseRequest(line, request))
+    {
+        return "ERROR bad request";
+    }
+
+    const Clock::time_point deadline = connection.accepted + std::chrono::milliseconds(request.deadline > 0 ? request.deadline : options.deadline);
+
+    RenderJob job = options.job;
+    job.in        = request.in;
+    job.width     = request.width;
+    job.height    = request.height;
+    job.views     = std::max<size_t>(1, std::min<size_t>(request.views, VIEW_POS.size()));
+    job.threads   = 1; // the workers are the parallelism
+    job.cancel    = [deadline] { return Clock::now() > deadline; };
+    setOutput(job, request.out);
+
+    if (Clock::now() > deadline)
+    {
+        return "TIMEOUT";
+    }
+
+    IndexedMesh mesh;
+    stl::MeshStats stats;
+    // the parse and the render stop on their own once the deadline passed
+    if (loadMesh(parser, job, mesh, stats, nullptr) != 0)
+    {
+        return Clock::now() > deadline ? "TIMEOUT" : "ERROR cannot parse " + job.in;
+    }
+
+    if (Clock::now() > deadline || renderViews(context, job, mesh, stats, nullptr) != 0)
+    {
+        return "TIMEOUT";
+    }
+
+    if (savePictures(context, job) != 0)
+    {
+        return "ERROR cannot write " + job.out;
+    }
+
+    return "OK";
+}
+
+static void workerLoop(BoundedQueue<Connection>& queue, const ServerOptions& options)
+{
+    RenderContext context;
+    stl::Parser parser;
+    parser.setThreadCount(1);
+
+    Connection connection;
+    while (queue.pop(connection))
+    {
+        std::string reply;
+        try
+        {
+            reply = serve(connection, options, context, parser);
+        }
+        catch (const std::exception& e)
+        {
+            reply = std::string("ERROR ") + e.what();
+        }
+
+        writeAll(connection.fd, reply + "\n");
+        close(connection.fd);
+    }
+}
+
+int runServer(const ServerOptions& options)
+{
+    const int listenFd = listenSocket(options.socketPath);
+    if (listenFd < 0)
+    {
+        return -1;
+    }
+
+    // the workers inherit a mask without the stop signals, so only the accept loop sees them
+    struct sigaction action = {};
+    action.sa_handler       = requestStop;
+    sigaction(SIGINT, &action, nullptr);
+    sigaction(SIGTERM, &action, nullptr);
+
+    sigset_t stopSignals, previous;
+    sigemptyset(&stopSignals);
+    sigaddset(&stopSignals, SIGINT);
+    sigaddset(&stopSignals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &stopSignals, &previous);
+
+    BoundedQueue<Connection> queue(options.queueSize);
+    std::vector<std::thread> workers(options.workers > 0 ? options.workers : std::max(1u, std::thread::hardware_concurrency()));
+    for (auto& worker : workers)
+    {
+        worker = std::thread(workerLoop, std::ref(queue), std::cref(options));
+    }
+
+    pthread_sigmask(SIG_SETMASK, &previous, nullptr);
+
+    std::cout << "Listening on " << options.socketPath << " with " << workers.size() << " workers" << std::endl;
+
+    while (!s_stop)
+    {
+        pollfd listening = { listenFd, POLLIN, 0 };
+        if (poll(&listening, 1, STOP_POLL_MS) <= 0)
+        {
+            continue;
+        }
+
+        Connection connection;
+        connection.fd       = accept4(listenFd, nullptr, nullptr, SOCK_CLOEXEC);
+        connection.accepted = Clock::now();
+        if (connection.fd < 0)
+        {
+            continue;
+        }
+
+        if (!queue.tryPush(connection))
+        {
+            writeAll(connection.fd, "BUSY\n");
+            close(connection.fd);
+        }
+    }
+
+    // stop taking requests, finish the queued ones
+    close(listenFd);
+    unlink(options.socketPath.c_str());
+
+    queue.close();
+    for (auto& worker : workers)
+    {
+        worker.join();
+    }
+
+    return 0;
+}
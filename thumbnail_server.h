@@ -0,0 +1,38 @@
+/*
+Copyright (C) 2017  Paul Kremer
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#pragma once
+
+#include <string>
+#include "render_job.h"
+
+struct ServerOptions
+{
+    std::string socketPath;
+    unsigned workers  = 0;     // requests rendered at a time, 0: one per hardware thread
+    size_t queueSize  = 64;    // accepted connections waiting for a worker, more are turned away
+    unsigned deadline = 30000; // milliseconds, for requests that do not bring their own
+    RenderJob job;             // the settings of every request, the format follows the out extension
+};
+
+// Serves ThumbnailRequests on a Unix socket until SIGINT or SIGTERM, see server_protocol.h.
+// Every worker keeps its own RenderContext, so a steady stream of same sized thumbnails
+// renders without allocating targets. A request past its deadline is answered with TIMEOUT
+// before the next step (parse, render, write) instead of being finished.
+// -1 if the socket cannot be set up, a live server already listening there included
+int runServer(const ServerOptions& options);